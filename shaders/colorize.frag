@@ -0,0 +1,47 @@
+#version 430
+
+precision highp float;
+precision highp int;
+
+in vec2 coord;
+out vec4 frag_color;
+
+uniform float palette_offset;       // moves the palette along the iterations
+uniform sampler1D tex;
+uniform sampler2D iterations;       // smooth count and PixelFlags, see IterationBuffer.h
+
+uniform bool resolve;               // write counts with the preview filled in instead of colors
+uniform bool has_preview;
+uniform sampler2D preview;          // earlier image, pixel p lies at p * preview_scale + preview_offset
+uniform float preview_scale;
+uniform vec2 preview_offset;
+
+const int PIXEL_INTERIOR = 1;
+const int PIXEL_NOT_ITERATED = 4;
+
+void main (void)
+{
+    vec2 pixel = texelFetch(iterations, ivec2(gl_FragCoord.xy), 0).rg;
+
+    if ((int(pixel.g) & PIXEL_NOT_ITERATED) != 0 && has_preview) {
+        ivec2 q = ivec2(floor(gl_FragCoord.xy * preview_scale + preview_offset));
+
+        if (all(greaterThanEqual(q, ivec2(0))) && all(lessThan(q, textureSize(preview, 0)))) {
+            pixel = texelFetch(preview, q, 0).rg;
+        }
+    }
+
+    if (resolve) {
+        frag_color = vec4(pixel, 0, 1);
+        return;
+    }
+
+    float p = pixel.r + palette_offset;
+    
+    frag_color = vec4(texture(tex,p/23.0).r, texture(tex,p/29.0).r, texture(tex,p/31.0).r, 1);
+                      
+
+    // Glitched pixels keep the count they had when detected
+    float x = (int(pixel.g) & (PIXEL_INTERIOR | PIXEL_NOT_ITERATED)) != 0 ? 0 : 1;
+    frag_color = frag_color * x;
+}
@@ -4,11 +4,32 @@ precision highp float;
 precision highp int;
 
 in vec2 coord;
-out vec4 frag_color;
+out vec2 iterations;    // smooth count and PixelFlags, colored by colorize.frag
 
 uniform dmat3 view;
 uniform int max_iterations;
-uniform sampler1D tex;
+uniform int periodicity_check;          // 0 disables cycle detection
+uniform double periodicity_tolerance;
+uniform bool masked;
+uniform sampler2D mask;                 // pixels above 0.5 are left alone, see subdivide.compute
+
+// Last orbit point of each pixel for higher limits, see GPUOrbitBuffer.h
+layout(std430) buffer orbit_points
+{
+    uvec4 orbit_z[];
+};
+
+layout(std430) buffer orbit_counts
+{
+    int orbit_iterations[];
+};
+
+uniform bool save_orbits;
+uniform bool continuing;                // Only go on with the saved orbits
+uniform ivec4 orbit_lattice;            // step, phase x, phase y of the pass and width of the image
+
+const int ORBIT_SETTLED = -1;           // see GPUOrbitBuffer.h
+const int ORBIT_ESCAPED = -2;
 
 dvec2 csquare(dvec2 z)
 {
@@ -17,21 +38,94 @@ dvec2 csquare(dvec2 z)
     return dvec2(x*x-y*y, 2.0*x*y);
 }
 
+const float PIXEL_INTERIOR = 1.0;    // PixelFlags, see IterationBuffer.h
+
+// Smooth count and flags of an orbit that ended at iteration it with
+// |z|^2 = r2, see orbit_pixel() in IterationBuffer.h
+vec2 orbit_pixel(int it, float r2)
+{
+    if (it >= max_iterations) return vec2(max_iterations, PIXEL_INTERIOR);
+
+    return vec2(float(it) + 1.0 - log2(0.5 * log2(r2)), 0.0);
+}
+
+// Main cardioid and period-2 disc, whose points never escape
+bool in_main_bulbs(dvec2 c)
+{
+    const double y2 = c.y*c.y;
+    const double xq = c.x - 0.25;
+    const double q = xq*xq + y2;
+    const dvec2 b = c + dvec2(1,0);
+
+    return q*(q + xq) <= 0.25*y2 || dot(b,b) <= 0.0625;
+}
+
 void main (void)
 {
+    if (masked && texelFetch(mask, ivec2(gl_FragCoord.xy), 0).r > 0.5) discard;
+
     dvec2 val = (view * dvec3(coord.x,coord.y,1)).xy;
-    
+
+    // Image pixel of the fragment, coarse passes render into a lattice
+    const ivec2 p = orbit_lattice.yz + ivec2(gl_FragCoord.xy) * orbit_lattice.x;
+    const int pixel = p.y * orbit_lattice.w + p.x;
+
     int it = 0;
     dvec2 z = vec2(0,0);
+
+    if (continuing) {
+        const int start = orbit_iterations[pixel];
+
+        if (start == ORBIT_ESCAPED) discard;
+
+        if (start == ORBIT_SETTLED) {
+            iterations = vec2(max_iterations, PIXEL_INTERIOR);
+            return;
+        }
+
+        if (start > 0) {
+            it = start;
+            z = dvec2(packDouble2x32(orbit_z[pixel].xy), packDouble2x32(orbit_z[pixel].zw));
+        }
+    }
+
+    bool settled = it == 0 && in_main_bulbs(val);
+    if (settled) it = max_iterations;
     
+    // Brent's cycle detection on every periodicity_check'th value, see Kernel.h
+    dvec2 saved = z;
+    int compares = 0;
+    int window = 1;
+    int next_check = periodicity_check > 0 ? it + periodicity_check : max_iterations + 1;
+
     while (it < max_iterations && dot(z,z) < 4.0) {
         it++;
         z = csquare(z) + val;
+
+        if (it == next_check) {
+            next_check += periodicity_check;
+
+            const dvec2 d = z - saved;
+            if (dot(d,d) <= periodicity_tolerance*periodicity_tolerance) {
+                it = max_iterations;
+                settled = true;
+                break;
+            }
+
+            if (++compares == window) {
+                saved = z;
+                compares = 0;
+                window *= 2;
+            }
+        }
     }
     
-    frag_color = vec4(texture(tex,it/23.0).r, texture(tex,it/29.0).r, texture(tex,it/31.0).r, 1);
-                      
+    if (save_orbits) {
+        const bool open = !settled && it >= max_iterations;
+
+        orbit_iterations[pixel] = open ? it : settled ? ORBIT_SETTLED : ORBIT_ESCAPED;
+        if (open) orbit_z[pixel] = uvec4(unpackDouble2x32(z.x), unpackDouble2x32(z.y));
+    }
 
-    float x = it==max_iterations ? 0 : 1;
-    frag_color = frag_color * x;
+    iterations = orbit_pixel(it, float(dot(z,z)));
 }
@@ -0,0 +1,187 @@
+#version 430
+
+precision highp float;
+precision highp int;
+
+in vec2 coord;
+out vec2 iterations;    // smooth count and PixelFlags, colored by colorize.frag
+
+// Numbers are unevaluated sums hi + lo of two floats (df64), which gives
+// about 48 bits of mantissa with single precision instructions. precise
+// keeps the compiler from simplifying the error terms away.
+
+uniform vec4 center;     // re.hi, re.lo, im.hi, im.lo
+uniform vec2 half_size;  // Distance from the center to the edges
+uniform int max_iterations;
+uniform int periodicity_check;          // 0 disables cycle detection
+uniform float periodicity_tolerance;
+uniform bool masked;
+uniform sampler2D mask;                 // pixels above 0.5 are left alone, see subdivide.compute
+
+// Last orbit point of each pixel for higher limits, see GPUOrbitBuffer.h
+layout(std430) buffer orbit_points
+{
+    uvec4 orbit_z[];
+};
+
+layout(std430) buffer orbit_counts
+{
+    int orbit_iterations[];
+};
+
+uniform bool save_orbits;
+uniform bool continuing;                // Only go on with the saved orbits
+uniform ivec4 orbit_lattice;            // step, phase x, phase y of the pass and width of the image
+
+const int ORBIT_SETTLED = -1;           // see GPUOrbitBuffer.h
+const int ORBIT_ESCAPED = -2;
+
+vec2 two_sum(float a, float b)
+{
+    precise float s = a + b;
+    precise float v = s - a;
+    precise float e = (a - (s - v)) + (b - v);
+    return vec2(s, e);
+}
+
+vec2 quick_two_sum(float a, float b)
+{
+    precise float s = a + b;
+    precise float e = b - (s - a);
+    return vec2(s, e);
+}
+
+vec2 two_prod(float a, float b)
+{
+    precise float p = a * b;
+    precise float e = fma(a, b, -p);
+    return vec2(p, e);
+}
+
+vec2 df_add(vec2 a, vec2 b)
+{
+    vec2 s = two_sum(a.x, b.x);
+    precise float lo = s.y + (a.y + b.y);
+    return quick_two_sum(s.x, lo);
+}
+
+vec2 df_mul(vec2 a, vec2 b)
+{
+    vec2 p = two_prod(a.x, b.x);
+    precise float lo = p.y + (a.x * b.y + a.y * b.x);
+    return quick_two_sum(p.x, lo);
+}
+
+vec2 df_sqr(vec2 a)
+{
+    vec2 p = two_prod(a.x, a.x);
+    precise float lo = p.y + 2.0 * a.x * a.y;
+    return quick_two_sum(p.x, lo);
+}
+
+const float PIXEL_INTERIOR = 1.0;    // PixelFlags, see IterationBuffer.h
+
+// Smooth count and flags of an orbit that ended at iteration it with
+// |z|^2 = r2, see orbit_pixel() in IterationBuffer.h
+vec2 orbit_pixel(int it, float r2)
+{
+    if (it >= max_iterations) return vec2(max_iterations, PIXEL_INTERIOR);
+
+    return vec2(float(it) + 1.0 - log2(0.5 * log2(r2)), 0.0);
+}
+
+// Main cardioid and period-2 disc, whose points never escape. Evaluated
+// in float pairs, single floats would misjudge pixels near the boundary.
+bool in_main_bulbs(vec2 x, vec2 y)
+{
+    const vec2 y2 = df_sqr(y);
+    const vec2 xq = df_add(x, vec2(-0.25, 0));
+    const vec2 q = df_add(df_sqr(xq), y2);
+
+    if (df_add(df_mul(q, df_add(q, xq)), -0.25 * y2).x <= 0.0) return true;
+
+    const vec2 x1 = df_add(x, vec2(1, 0));
+    return df_add(df_add(df_sqr(x1), y2), vec2(-0.0625, 0)).x <= 0.0;
+}
+
+void main (void)
+{
+    if (masked && texelFetch(mask, ivec2(gl_FragCoord.xy), 0).r > 0.5) discard;
+
+    // The offset from the center only needs single precision.
+    const vec2 c_re = df_add(center.xy, vec2(coord.x * half_size.x, 0));
+    const vec2 c_im = df_add(center.zw, vec2(coord.y * half_size.y, 0));
+
+    // Image pixel of the fragment, coarse passes render into a lattice
+    const ivec2 p = orbit_lattice.yz + ivec2(gl_FragCoord.xy) * orbit_lattice.x;
+    const int pixel = p.y * orbit_lattice.w + p.x;
+
+    int it = 0;
+    vec2 x = vec2(0);
+    vec2 y = vec2(0);
+
+    if (continuing) {
+        const int start = orbit_iterations[pixel];
+
+        if (start == ORBIT_ESCAPED) discard;
+
+        if (start == ORBIT_SETTLED) {
+            iterations = vec2(max_iterations, PIXEL_INTERIOR);
+            return;
+        }
+
+        if (start > 0) {
+            it = start;
+            x = uintBitsToFloat(orbit_z[pixel].xy);
+            y = uintBitsToFloat(orbit_z[pixel].zw);
+        }
+    }
+
+    bool settled = it == 0 && in_main_bulbs(c_re, c_im);
+    if (settled) it = max_iterations;
+
+    vec2 x2 = df_sqr(x);
+    vec2 y2 = df_sqr(y);
+
+    // Brent's cycle detection on every periodicity_check'th value, see Kernel.h
+    vec2 saved_x = x;
+    vec2 saved_y = y;
+    int compares = 0;
+    int window = 1;
+    int next_check = periodicity_check > 0 ? it + periodicity_check : max_iterations + 1;
+
+    while (it < max_iterations && x2.x + y2.x < 4.0) {
+        it++;
+        y = df_add(2.0 * df_mul(x, y), c_im);
+        x = df_add(df_add(x2, -y2), c_re);
+        x2 = df_sqr(x);
+        y2 = df_sqr(y);
+
+        if (it == next_check) {
+            next_check += periodicity_check;
+
+            const vec2 d = vec2(df_add(x, -saved_x).x, df_add(y, -saved_y).x);
+            if (dot(d,d) <= periodicity_tolerance*periodicity_tolerance) {
+                it = max_iterations;
+                settled = true;
+                break;
+            }
+
+            if (++compares == window) {
+                saved_x = x;
+                saved_y = y;
+                compares = 0;
+                window *= 2;
+            }
+        }
+    }
+
+    if (save_orbits) {
+        const bool open = !settled && it >= max_iterations;
+
+        orbit_iterations[pixel] = open ? it : settled ? ORBIT_SETTLED : ORBIT_ESCAPED;
+        if (open) orbit_z[pixel] = uvec4(floatBitsToUint(x), floatBitsToUint(y));
+    }
+
+    iterations = orbit_pixel(it, x2.x + y2.x);
+}
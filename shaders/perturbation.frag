@@ -0,0 +1,289 @@
+#version 430
+
+precision highp float;
+precision highp int;
+
+in vec2 coord;
+out vec2 iterations;    // smooth count and PixelFlags, colored by colorize.frag
+
+layout(std430) buffer reference_orbit
+{
+    dvec2 orbit[];
+};
+
+layout(std430) buffer series_coefficients
+{
+    dvec2 coefficients[];
+};
+
+struct BLAStep
+{
+    dvec2 a;
+    dvec2 b;
+    double radius;
+    double padding;
+};
+
+layout(std430) buffer bla_steps
+{
+    BLAStep steps[];
+};
+
+uniform int reference_length;
+uniform int bla_levels;
+uniform int series_skip;
+uniform int series_terms;
+uniform double series_radius;
+uniform dvec2 reference_point;
+uniform dvec2 offset;
+uniform double step;
+uniform int scale;      // offset and step are multiplied by 2^scale
+uniform int max_iterations;
+uniform int periodicity_check;          // 0 disables cycle detection
+uniform double periodicity_tolerance;
+uniform bool masked;
+uniform sampler2D mask;                 // pixels above 0.5 are left alone, see subdivide.compute
+
+dvec2 cmul(dvec2 a, dvec2 b)
+{
+    return dvec2(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+// Complex m * 2^e for deltas below the double range, see FloatExp.h.
+// The mantissa is only renormalized when it drifts far away from 1.
+struct floatexp2
+{
+    dvec2 m;
+    int e;
+};
+
+dvec2 fe_ldexp(dvec2 m, int e)
+{
+    return ldexp(m, ivec2(clamp(e, -1100, 1100)));
+}
+
+floatexp2 fe_adjust(floatexp2 a)
+{
+    const double f = max(abs(a.m.x), abs(a.m.y));
+
+    if (f != 0.0 && (f > ldexp(1.0lf, 256) || f < ldexp(1.0lf, -256))) {
+        int k;
+        frexp(f, k);
+        a.m = ldexp(a.m, ivec2(-k));
+        a.e += k;
+    }
+    return a;
+}
+
+bool fe_fits_double(floatexp2 a)
+{
+    const double f = max(abs(a.m.x), abs(a.m.y));
+    if (f == 0.0) return true;
+
+    int k;
+    frexp(f, k);
+    return k + a.e > -960 && k + a.e < 960;
+}
+
+floatexp2 fe_add(floatexp2 a, floatexp2 b)
+{
+    if (a.m == dvec2(0)) return b;
+    if (b.m == dvec2(0)) return a;
+
+    if (a.e >= b.e) {
+        return fe_adjust(floatexp2(a.m + fe_ldexp(b.m, b.e - a.e), a.e));
+    } else {
+        return fe_adjust(floatexp2(fe_ldexp(a.m, a.e - b.e) + b.m, b.e));
+    }
+}
+
+floatexp2 fe_mul(floatexp2 a, floatexp2 b)
+{
+    return fe_adjust(floatexp2(cmul(a.m, b.m), a.e + b.e));
+}
+
+floatexp2 fe_mul(dvec2 a, floatexp2 b)
+{
+    return fe_adjust(floatexp2(cmul(a, b.m), b.e));
+}
+
+// Largest step of the BLA table that is valid at iteration n, see BLA.h.
+// Level k holds reference_length >> k steps.
+int bla_lookup(int n, dvec2 d, out BLAStep step)
+{
+    if (bla_levels == 0 || n <= 0 || n >= reference_length) return 0;
+
+    const double d2 = dot(d,d);
+
+    step = steps[n];
+    if (!(d2 < step.radius * step.radius)) return 0;
+
+    int level = min(findLSB(n), bla_levels - 1);
+
+    int offset = 0;
+    for (int j = 0; j < level; ++j) {
+        offset += reference_length >> j;
+    }
+
+    for (; level > 0; --level) {
+        const int index = n >> level;
+
+        if (index < (reference_length >> level)) {
+            BLAStep candidate = steps[offset + index];
+
+            if (d2 < candidate.radius * candidate.radius) {
+                step = candidate;
+                return 1 << level;
+            }
+        }
+
+        offset -= reference_length >> (level - 1);
+    }
+
+    return 1;
+}
+
+const float PIXEL_INTERIOR = 1.0;    // PixelFlags, see IterationBuffer.h
+const float PIXEL_GLITCHED = 2.0;
+
+// Pauldelbrot's criterion |Z + delta| < 1e-3 |Z|, compared squared, see
+// perturbation_kernel()
+const double glitch_tolerance = 1e-6;
+
+// Smooth count and flags of an orbit that ended at iteration it with
+// |z|^2 = r2, see orbit_pixel() in IterationBuffer.h
+vec2 orbit_pixel(int it, float r2)
+{
+    if (it >= max_iterations) return vec2(max_iterations, PIXEL_INTERIOR);
+
+    return vec2(float(it) + 1.0 - log2(0.5 * log2(r2)), 0.0);
+}
+
+// Main cardioid and period-2 disc, whose points never escape
+bool in_main_bulbs(dvec2 c)
+{
+    const double y2 = c.y*c.y;
+    const double xq = c.x - 0.25;
+    const double q = xq*xq + y2;
+    const dvec2 b = c + dvec2(1,0);
+
+    return q*(q + xq) <= 0.25*y2 || dot(b,b) <= 0.0625;
+}
+
+void main (void)
+{
+    if (masked && texelFetch(mask, ivec2(gl_FragCoord.xy), 0).r > 0.5) discard;
+
+    // Pixel position relative to the reference, exact at any depth
+    dvec2 dc = offset + dvec2(floor(gl_FragCoord.xy)) * step;
+
+    // Deep pixels collapse onto the reference in double precision, good
+    // enough to tell the main cardioid or period-2 bulb.
+    if (in_main_bulbs(reference_point + (scale == 0 ? dc : dvec2(0)))) {
+        iterations = vec2(max_iterations, PIXEL_INTERIOR);
+        return;
+    }
+
+    int it = 0;
+    dvec2 d = dvec2(0,0);
+    dvec2 z;
+
+    if (scale != 0) {
+        // Deltas below the double range start out in floatexp until they
+        // grew large enough. delta_c is negligible against them by then.
+        const floatexp2 dc_exp = fe_adjust(floatexp2(dc, scale));
+        const int end = min(max_iterations, reference_length);
+
+        floatexp2 d_exp = dc_exp;
+        it = min(1, end);
+
+        while (it < end && !fe_fits_double(d_exp)) {
+            if (dot(orbit[it], orbit[it]) >= 4.0) break;
+
+            BLAStep step;
+            const int skip = bla_lookup(it, fe_ldexp(d_exp.m, d_exp.e), step);
+
+            if (skip > 0) {
+                d_exp = fe_add(fe_mul(step.a, d_exp), fe_mul(step.b, dc_exp));
+                it += skip;
+                continue;
+            }
+
+            d_exp = fe_add(fe_add(fe_mul(2.0*orbit[it], d_exp), fe_mul(d_exp, d_exp)), dc_exp);
+            it++;
+        }
+
+        d = fe_ldexp(d_exp.m, d_exp.e);
+        dc = fe_ldexp(dc_exp.m, dc_exp.e);
+    } else if (series_skip > 0) {
+        // Start where the series approximation stops being accurate
+        dvec2 u = dc / series_radius;
+
+        for (int k = series_terms - 1; k >= 0; --k) {
+            d = cmul(d + coefficients[k], u);
+        }
+
+        it = series_skip;
+    }
+
+    // Brent's cycle detection on the full orbit, see perturbation_kernel().
+    // The distance to the saved sample keeps the precision of the deltas.
+    int saved = it;
+    dvec2 saved_d = d;
+    int compares = 0;
+    int window = 1;
+    int next_check = periodicity_check > 0 ? it + periodicity_check : max_iterations + 1;
+
+    bool glitched = false;
+
+    while (it < max_iterations && it < reference_length) {
+        z = orbit[it] + d;
+
+        if (dot(z,z) >= 4.0) break;
+
+        if (dot(z,z) < glitch_tolerance * dot(orbit[it], orbit[it])) {
+            glitched = true;
+            break;
+        }
+
+        if (it >= next_check) {
+            // BLA steps may have passed several checks
+            next_check += (it - next_check) / periodicity_check * periodicity_check + periodicity_check;
+
+            const dvec2 delta = (orbit[it] - orbit[saved]) + (d - saved_d);
+            if (dot(delta,delta) <= periodicity_tolerance*periodicity_tolerance) {
+                it = max_iterations;
+                break;
+            }
+
+            if (++compares == window) {
+                saved = it;
+                saved_d = d;
+                compares = 0;
+                window *= 2;
+            }
+        }
+
+        BLAStep step;
+        const int skip = bla_lookup(it, d, step);
+
+        if (skip > 0) {
+            d = cmul(step.a, d) + cmul(step.b, dc);
+            it += skip;
+            continue;
+        }
+
+        d = cmul(2.0*orbit[it] + d, d) + dc;
+        it++;
+    }
+
+    // The reference escaped first, nothing left to compare with
+    if (!glitched && it == reference_length && it < max_iterations) {
+        z = orbit[it] + d;
+        glitched = dot(z,z) < 4.0;
+    }
+
+    // Glitched pixels are rendered again from another reference, see
+    // Mandelbrot::correct_glitches()
+    iterations = glitched ? vec2(it, PIXEL_GLITCHED) : orbit_pixel(it, float(dot(z,z)));
+}
@@ -0,0 +1,38 @@
+#include "Framebuffer.h"
+
+GL::Framebuffer::Framebuffer()
+    : _framebuffer(0)
+{
+    glGenFramebuffers(1, &_framebuffer);
+}
+
+
+GL::Framebuffer::~Framebuffer()
+{
+    glDeleteFramebuffers(1, &_framebuffer);
+}
+
+
+void GL::Framebuffer::attach(Texture& texture)
+{
+    bind();
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture.texture_name(), 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Framebuffer: Texture can't be rendered to." << endl;
+    }
+
+    unbind();
+}
+
+
+void GL::Framebuffer::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+}
+
+
+void GL::Framebuffer::unbind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
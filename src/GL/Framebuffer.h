@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common.h"
+
+#include "Texture.h"
+
+namespace GL
+{
+
+    /**
+     * Framebuffer object that renders into a texture instead of the window.
+     */
+    class Framebuffer : public noncopyable
+    {
+        GLuint _framebuffer;
+
+    public:
+
+        Framebuffer();
+        ~Framebuffer();
+
+        /**
+         * Render into the first level of texture from now on.
+         */
+        void attach(Texture& texture);
+
+        void bind() const;
+        void unbind() const;
+    };
+
+}
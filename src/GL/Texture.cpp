@@ -182,6 +182,31 @@ void GL::Texture::read_back(Image& image) {
     unbind();
 }
 
+void GL::Texture::load(const float* data)
+{
+    bind();
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    switch (_dimensions) {
+    case 1:
+        glTexSubImage1D(_target, 0, 0, _width, _format, GL_FLOAT, data);
+        break;
+    case 2:
+        glTexSubImage2D(_target, 0, 0, 0, _width, _height, _format, GL_FLOAT, data);
+        break;
+    case 3:
+        glTexSubImage3D(_target, 0, 0, 0, 0, _width, _height, _depth, _format, GL_FLOAT, data);
+        break;
+    default:
+        assert(0);
+    }
+
+    generate_mipmaps();
+
+    unbind();
+}
+
 void GL::Tex::bind()
 {
     if (_bound_unit != 0)
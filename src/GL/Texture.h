@@ -159,6 +159,12 @@ namespace GL {
          */
         void read_back(Image& image);
 
+        /**
+         * Replace the whole texture content.
+         * @param data Float data matching the texture format and size.
+         */
+        void load(const float* data);
+
         void generate_mipmaps();
 
         int width() const { return _width; }
@@ -116,6 +116,20 @@ template <> struct gltype_info<GLfloat>
     }
 };
 
+template <> struct gltype_info<GLdouble>
+{
+    static const GLenum type = GL_DOUBLE;
+    static const GLenum format = GL_RED;
+
+    static const GLint components = 1;
+
+    static void set_uniform(GLint location, GLdouble value)
+    {
+        glUniform1d(location, value);
+    }
+
+};
+
 template <> struct gltype_info<dvec2>
 {
     static const GLenum type = GL_DOUBLE;
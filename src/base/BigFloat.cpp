@@ -0,0 +1,699 @@
+/******************************************************************************\
+ * This file is part of Micropolis.                                           *
+ *                                                                            *
+ * Micropolis is free software: you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation, either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * Micropolis is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with Micropolis.  If not, see <http://www.gnu.org/licenses/>.        *
+\******************************************************************************/
+
+
+#include "BigFloat.h"
+
+#include <cmath>
+
+typedef unsigned __int128 dlimb;
+
+
+/**
+ * Read 64 bits of a little-endian limb array starting at bit lo.
+ * Bits outside of the array read as zero.
+ */
+static BigFloat::limb get_bits(const vector<BigFloat::limb>& m, long lo)
+{
+    const long len = (long)m.size();
+    const long word = lo >= 0 ? lo / 64 : -((-lo + 63) / 64);
+    const int offset = (int)(lo - word * 64);
+
+    BigFloat::limb low  = (word >= 0 && word < len) ? m[word] : 0;
+    BigFloat::limb high = (word+1 >= 0 && word+1 < len) ? m[word+1] : 0;
+
+    return offset ? (low >> offset) | (high << (64 - offset)) : low;
+}
+
+
+/**
+ * out[j] = get_bits(m, lo + 64*j) for j < count. Only the limbs at the
+ * ends of the array need the range checks of get_bits.
+ */
+static void get_limbs(const vector<BigFloat::limb>& m, long lo, BigFloat::limb* out, long count)
+{
+    const long len = (long)m.size();
+    const long word = lo >= 0 ? lo / 64 : -((-lo + 63) / 64);
+    const int offset = (int)(lo - word * 64);
+
+    const long begin = minimum(count, maximum(0L, -word));
+    const long end = maximum(begin, minimum(count, len - 1 - word));
+
+    for (long j = 0; j < begin; ++j) {
+        out[j] = get_bits(m, lo + 64*j);
+    }
+
+    const BigFloat::limb* src = m.data() + word;
+
+    if (offset) {
+        for (long j = begin; j < end; ++j) {
+            out[j] = (src[j] >> offset) | (src[j+1] << (64 - offset));
+        }
+    } else {
+        for (long j = begin; j < end; ++j) {
+            out[j] = src[j];
+        }
+    }
+
+    for (long j = end; j < count; ++j) {
+        out[j] = get_bits(m, lo + 64*j);
+    }
+}
+
+
+static int compare_magnitudes(const vector<BigFloat::limb>& a, const vector<BigFloat::limb>& b)
+{
+    for (long i = (long)a.size()-1; i >= 0; --i) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Operand length in limbs from which Karatsuba beats the schoolbook method.
+ * Reference orbits below a few thousand bits stay with schoolbook.
+ */
+static const size_t karatsuba_threshold = 48;
+
+
+/**
+ * r[0..nr) += a[0..na) with na <= nr.
+ * @return Carry out of the top limb.
+ */
+static BigFloat::limb add_limbs(BigFloat::limb* r, size_t nr, const BigFloat::limb* a, size_t na)
+{
+    BigFloat::limb carry = 0;
+    size_t j = 0;
+
+    for (; j < na; ++j) {
+        dlimb s = (dlimb)r[j] + a[j] + carry;
+        r[j] = (BigFloat::limb)s;
+        carry = (BigFloat::limb)(s >> 64);
+    }
+    for (; carry && j < nr; ++j) {
+        carry = ++r[j] == 0 ? 1 : 0;
+    }
+
+    return carry;
+}
+
+
+/**
+ * r[0..nr) -= a[0..na) with na <= nr and a <= r.
+ */
+static void sub_limbs(BigFloat::limb* r, size_t nr, const BigFloat::limb* a, size_t na)
+{
+    BigFloat::limb borrow = 0;
+    size_t j = 0;
+
+    for (; j < na; ++j) {
+        BigFloat::limb d = r[j] - a[j] - borrow;
+        borrow = (r[j] < a[j] || (r[j] == a[j] && borrow)) ? 1 : 0;
+        r[j] = d;
+    }
+    for (; borrow && j < nr; ++j) {
+        borrow = r[j]-- == 0 ? 1 : 0;
+    }
+}
+
+
+/**
+ * p[0..na+nb) = a * b
+ */
+static void mul_schoolbook(const BigFloat::limb* a, size_t na, const BigFloat::limb* b, size_t nb, BigFloat::limb* p)
+{
+    std::fill(p, p + na + nb, 0);
+
+    for (size_t i = 0; i < na; ++i) {
+        BigFloat::limb carry = 0;
+        for (size_t j = 0; j < nb; ++j) {
+            dlimb t = (dlimb)a[i] * b[j] + p[i+j] + carry;
+            p[i+j] = (BigFloat::limb)t;
+            carry = (BigFloat::limb)(t >> 64);
+        }
+        p[i+nb] = carry;
+    }
+}
+
+
+/**
+ * p[0..2n) = a * a
+ * Each cross product a_i * a_j appears twice in the square, so it is
+ * computed once and the sum doubled, which halves the multiplications.
+ */
+static void sqr_schoolbook(const BigFloat::limb* a, size_t n, BigFloat::limb* p)
+{
+    std::fill(p, p + 2*n, 0);
+
+    for (size_t i = 0; i + 1 < n; ++i) {
+        BigFloat::limb carry = 0;
+        for (size_t j = i+1; j < n; ++j) {
+            dlimb t = (dlimb)a[i] * a[j] + p[i+j] + carry;
+            p[i+j] = (BigFloat::limb)t;
+            carry = (BigFloat::limb)(t >> 64);
+        }
+        p[i+n] = carry;
+    }
+
+    BigFloat::limb top = 0;
+    for (size_t j = 0; j < 2*n; ++j) {
+        BigFloat::limb next = p[j] >> 63;
+        p[j] = (p[j] << 1) | top;
+        top = next;
+    }
+
+    BigFloat::limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        dlimb sq = (dlimb)a[i] * a[i];
+        dlimb lo = (dlimb)p[2*i] + (BigFloat::limb)sq + carry;
+        p[2*i] = (BigFloat::limb)lo;
+        dlimb hi = (dlimb)p[2*i+1] + (BigFloat::limb)(sq >> 64) + (BigFloat::limb)(lo >> 64);
+        p[2*i+1] = (BigFloat::limb)hi;
+        carry = (BigFloat::limb)(hi >> 64);
+    }
+}
+
+
+static void mul_karatsuba(const BigFloat::limb* a, const BigFloat::limb* b, size_t n, BigFloat::limb* p);
+
+
+/**
+ * p[0..2n) = a * b for two n limb operands, or a^2 if a and b are the same.
+ */
+static void mul_square(const BigFloat::limb* a, const BigFloat::limb* b, size_t n, BigFloat::limb* p)
+{
+    if (n >= karatsuba_threshold) {
+        mul_karatsuba(a, b, n, p);
+    } else if (a == b) {
+        sqr_schoolbook(a, n, p);
+    } else {
+        mul_schoolbook(a, n, b, n, p);
+    }
+}
+
+
+/**
+ * Split both operands into halves a = a1 * B^h + a0 and use
+ * a*b = z2 * B^2h + (z1 - z2 - z0) * B^h + z0 with z0 = a0*b0, z2 = a1*b1
+ * and z1 = (a0+a1)*(b0+b1), three half size products instead of four.
+ * For a == b all three products are squares.
+ */
+static void mul_karatsuba(const BigFloat::limb* a, const BigFloat::limb* b, size_t n, BigFloat::limb* p)
+{
+    const size_t h = n / 2;
+    const size_t l = n - h;
+
+    // Low halves have h limbs, high halves l >= h limbs.
+    vector<BigFloat::limb> sa(l+1, 0), sb(l+1, 0), z1(2*l+2);
+
+    std::copy(a + h, a + n, sa.begin());
+    sa[l] = add_limbs(sa.data(), l, a, h);
+
+    if (a != b) {
+        std::copy(b + h, b + n, sb.begin());
+        sb[l] = add_limbs(sb.data(), l, b, h);
+    }
+
+    // z0 and z2 go straight into their places in the product.
+    std::fill(p, p + 2*n, 0);
+    mul_square(a, a == b ? a : b, h, p);
+    mul_square(a + h, a == b ? a + h : b + h, l, p + 2*h);
+    mul_square(sa.data(), a == b ? sa.data() : sb.data(), l+1, z1.data());
+
+    sub_limbs(z1.data(), z1.size(), p, 2*h);
+    sub_limbs(z1.data(), z1.size(), p + 2*h, 2*l);
+
+    // The middle term is below B^(n+l), higher limbs of z1 are zero.
+    add_limbs(p + h, 2*n - h, z1.data(), minimum(z1.size(), 2*n - h));
+}
+
+
+BigFloat::BigFloat(int bits)
+    : _mantissa(maximum(1, round_up_div(bits, limb_bits)), 0)
+    , _exponent(0)
+    , _negative(false)
+{
+}
+
+
+BigFloat::BigFloat(double value, int bits)
+    : _mantissa(maximum(1, round_up_div(bits, limb_bits)), 0)
+    , _exponent(0)
+    , _negative(false)
+{
+    if (value == 0.0) return;
+
+    int e;
+    double f = frexp(fabs(value), &e);
+
+    _mantissa.back() = (limb)ldexp(f, limb_bits);
+    _exponent = e;
+    _negative = value < 0;
+}
+
+
+void BigFloat::set_precision(int bits)
+{
+    const size_t n = maximum(1, round_up_div(bits, limb_bits));
+
+    if (n > _mantissa.size()) {
+        _mantissa.insert(_mantissa.begin(), n - _mantissa.size(), 0);
+    } else if (n < _mantissa.size()) {
+        _mantissa.erase(_mantissa.begin(), _mantissa.begin() + (_mantissa.size() - n));
+    }
+}
+
+
+double BigFloat::to_double() const
+{
+    if (is_zero()) return 0.0;
+
+    const size_t n = _mantissa.size();
+
+    double v = ldexp((double)_mantissa[n-1], (int)maximum(_exponent - 64, -2000L));
+    if (n > 1) {
+        v += ldexp((double)_mantissa[n-2], (int)maximum(_exponent - 128, -2000L));
+    }
+
+    return _negative ? -v : v;
+}
+
+
+/**
+ * Store the value m / 2^(64*m.size()) * 2^exponent, keeping the current
+ * mantissa length.
+ */
+void BigFloat::normalize(vector<limb>& m, long exponent, bool negative)
+{
+    long top = (long)m.size() - 1;
+    while (top >= 0 && m[top] == 0) --top;
+
+    if (top < 0) {
+        std::fill(_mantissa.begin(), _mantissa.end(), 0);
+        _exponent = 0;
+        _negative = false;
+        return;
+    }
+
+    const long zeros = ((long)m.size() - 1 - top) * 64 + __builtin_clzll(m[top]);
+    const long n = (long)_mantissa.size();
+    const long msb = (long)m.size() * 64 - zeros;
+
+    get_limbs(m, msb - 64 * n, _mantissa.data(), n);
+
+    _exponent = exponent - zeros;
+    _negative = negative;
+}
+
+
+void BigFloat::add(const BigFloat& other, bool negate)
+{
+    const size_t n = maximum(_mantissa.size(), other._mantissa.size());
+    const bool other_negative = other._negative != negate;
+
+    if (other.is_zero()) {
+        set_precision(n * limb_bits);
+        return;
+    }
+
+    if (is_zero()) {
+        *this = other;
+        _negative = other_negative;
+        set_precision(n * limb_bits);
+        return;
+    }
+
+    // Fixed point with a carry limb on top and a guard limb below the
+    // mantissa, scaled to the larger exponent.
+    const long len = n + 2;
+    const long e = maximum(_exponent, other._exponent);
+
+    // Scratch space is reused, reference orbits call this millions of times.
+    static thread_local vector<limb> a, b;
+    a.resize(len);
+    b.resize(len);
+
+    const long shift_a = 64 * (len-1) - 64 * (long)_mantissa.size() + _exponent - e;
+    const long shift_b = 64 * (len-1) - 64 * (long)other._mantissa.size() + other._exponent - e;
+
+    get_limbs(_mantissa, -shift_a, a.data(), len);
+    get_limbs(other._mantissa, -shift_b, b.data(), len);
+
+    bool negative = _negative;
+
+    if (_negative == other_negative) {
+        limb carry = 0;
+        for (long j = 0; j < len; ++j) {
+            dlimb s = (dlimb)a[j] + b[j] + carry;
+            a[j] = (limb)s;
+            carry = (limb)(s >> 64);
+        }
+    } else {
+        if (compare_magnitudes(a, b) < 0) {
+            std::swap(a, b);
+            negative = other_negative;
+        }
+
+        limb borrow = 0;
+        for (long j = 0; j < len; ++j) {
+            limb d = a[j] - b[j] - borrow;
+            borrow = (a[j] < b[j] || (a[j] == b[j] && borrow)) ? 1 : 0;
+            a[j] = d;
+        }
+    }
+
+    if (_mantissa.size() < n) {
+        _mantissa.resize(n);
+    }
+
+    normalize(a, e + 64, negative);
+}
+
+
+BigFloat BigFloat::operator- () const
+{
+    BigFloat r(*this);
+    if (!r.is_zero()) {
+        r._negative = !r._negative;
+    }
+    return r;
+}
+
+
+BigFloat& BigFloat::operator+= (const BigFloat& other)
+{
+    add(other, false);
+    return *this;
+}
+
+
+BigFloat& BigFloat::operator-= (const BigFloat& other)
+{
+    add(other, true);
+    return *this;
+}
+
+
+BigFloat& BigFloat::operator*= (const BigFloat& other)
+{
+    const size_t na = _mantissa.size();
+    const size_t nb = other._mantissa.size();
+
+    if (is_zero() || other.is_zero()) {
+        set_precision(maximum(na, nb) * limb_bits);
+        std::fill(_mantissa.begin(), _mantissa.end(), 0);
+        _exponent = 0;
+        _negative = false;
+        return *this;
+    }
+
+    static thread_local vector<limb> p;
+    p.resize(na + nb);
+
+    if (na == nb) {
+        mul_square(_mantissa.data(), other._mantissa.data(), na, p.data());
+    } else {
+        mul_schoolbook(_mantissa.data(), na, other._mantissa.data(), nb, p.data());
+    }
+
+    if (na < nb) {
+        _mantissa.resize(nb);
+    }
+
+    normalize(p, _exponent + other._exponent, _negative != other._negative);
+    return *this;
+}
+
+
+BigFloat& BigFloat::square()
+{
+    if (is_zero()) return *this;
+
+    const size_t n = _mantissa.size();
+    static thread_local vector<limb> p;
+    p.resize(2*n);
+
+    mul_square(_mantissa.data(), _mantissa.data(), n, p.data());
+
+    normalize(p, 2*_exponent, false);
+    return *this;
+}
+
+
+BigFloat& BigFloat::mul_2exp(long e)
+{
+    if (!is_zero()) {
+        _exponent += e;
+    }
+    return *this;
+}
+
+
+bool operator== (const BigFloat& a, const BigFloat& b)
+{
+    if (a._negative != b._negative || a._exponent != b._exponent) {
+        return false;
+    }
+
+    // Compare from the top, missing limbs of the shorter mantissa are zero.
+    const size_t na = a._mantissa.size();
+    const size_t nb = b._mantissa.size();
+
+    for (size_t i = 0; i < maximum(na, nb); ++i) {
+        const BigFloat::limb la = i < na ? a._mantissa[na - 1 - i] : 0;
+        const BigFloat::limb lb = i < nb ? b._mantissa[nb - 1 - i] : 0;
+
+        if (la != lb) return false;
+    }
+
+    return true;
+}
+
+
+BigFloat operator+ (const BigFloat& a, const BigFloat& b)
+{
+    BigFloat r(a);
+    r += b;
+    return r;
+}
+
+
+BigFloat operator- (const BigFloat& a, const BigFloat& b)
+{
+    BigFloat r(a);
+    r -= b;
+    return r;
+}
+
+
+BigFloat operator* (const BigFloat& a, const BigFloat& b)
+{
+    BigFloat r(a);
+    r *= b;
+    return r;
+}
+
+
+void BigFloat::mul_small(limb factor)
+{
+    if (is_zero()) return;
+
+    const size_t n = _mantissa.size();
+    vector<limb> w(n + 1);
+
+    limb carry = 0;
+    for (size_t j = 0; j < n; ++j) {
+        dlimb t = (dlimb)_mantissa[j] * factor + carry;
+        w[j] = (limb)t;
+        carry = (limb)(t >> 64);
+    }
+    w[n] = carry;
+
+    normalize(w, _exponent + 64, _negative);
+}
+
+
+void BigFloat::div_small(limb divisor)
+{
+    if (is_zero()) return;
+
+    // One extra limb of quotient below the mantissa.
+    const size_t n = _mantissa.size();
+    vector<limb> q(n + 1);
+
+    dlimb rem = 0;
+    for (long j = n; j >= 0; --j) {
+        dlimb cur = (rem << 64) | (j > 0 ? _mantissa[j-1] : 0);
+        q[j] = (limb)(cur / divisor);
+        rem = cur % divisor;
+    }
+
+    normalize(q, _exponent, _negative);
+}
+
+
+bool BigFloat::parse(const string& s, int bits, BigFloat& out)
+{
+    size_t pos = s.find_first_not_of(" \t");
+    if (pos == string::npos) return false;
+
+    bool negative = false;
+    if (s[pos] == '-' || s[pos] == '+') {
+        negative = s[pos] == '-';
+        ++pos;
+    }
+
+    string digits;
+    long exponent10 = 0;
+    bool seen_point = false;
+
+    for (; pos < s.size(); ++pos) {
+        const char c = s[pos];
+        if (c >= '0' && c <= '9') {
+            digits += c;
+            if (seen_point) --exponent10;
+        } else if (c == '.' && !seen_point) {
+            seen_point = true;
+        } else {
+            break;
+        }
+    }
+
+    if (digits.empty()) return false;
+
+    if (pos < s.size() && (s[pos] == 'e' || s[pos] == 'E')) {
+        size_t end;
+        try {
+            exponent10 += std::stol(s.substr(pos+1), &end);
+        } catch (...) {
+            return false;
+        }
+        pos += 1 + end;
+    }
+
+    if (s.find_first_not_of(" \t", pos) != string::npos) return false;
+
+    // log2(10) bits per digit plus one guard limb
+    bits = maximum(bits, (int)(digits.size() * 3.33) + limb_bits);
+
+    BigFloat value(bits);
+
+    const limb chunk_scale = 10000000000000000000ULL; // 10^19
+
+    for (size_t i = 0; i < digits.size(); i += 19) {
+        const string chunk = digits.substr(i, 19);
+
+        limb scale = 1;
+        for (size_t k = 0; k < chunk.size(); ++k) scale *= 10;
+
+        value.mul_small(scale);
+
+        BigFloat part(bits);
+        vector<limb> w(1, std::stoull(chunk));
+        part.normalize(w, 64, false);
+        value += part;
+    }
+
+    for (; exponent10 >= 19; exponent10 -= 19) value.mul_small(chunk_scale);
+    for (; exponent10 > 0; --exponent10) value.mul_small(10);
+    for (; exponent10 <= -19; exponent10 += 19) value.div_small(chunk_scale);
+    for (; exponent10 < 0; ++exponent10) value.div_small(10);
+
+    value._negative = negative && !value.is_zero();
+
+    out = value;
+    return true;
+}
+
+
+string BigFloat::to_string(int digits) const
+{
+    if (is_zero()) return "0";
+
+    if (_exponent > 64) {
+        // Far outside of the range this class is used for.
+        std::stringstream ss;
+        ss << std::setprecision(17) << to_double();
+        return ss.str();
+    }
+
+    if (digits <= 0) {
+        // Leave a few digits for the truncation error of earlier operations.
+        digits = maximum(1, (int)(get_precision() * 0.30103) - 4);
+    }
+
+    const long n = (long)_mantissa.size();
+
+    limb integer = _exponent > 0 ? get_bits(_mantissa, 64 * n - _exponent) : 0;
+
+    // Fraction as fixed point number with len limbs.
+    const long len = n + 2 + maximum(0L, -_exponent) / 64;
+    const long shift = 64 * len - 64 * n + _exponent;
+
+    vector<limb> fraction(len);
+    get_limbs(_mantissa, -shift, fraction.data(), len);
+
+    // Produce one digit more than requested for rounding.
+    string decimals;
+    int significant = integer > 0 ? (int)::to_string(integer).size() : 0;
+
+    while (significant <= digits) {
+        limb carry = 0;
+        bool nonzero = false;
+        for (long j = 0; j < len; ++j) {
+            dlimb t = (dlimb)fraction[j] * 10 + carry;
+            fraction[j] = (limb)t;
+            carry = (limb)(t >> 64);
+            nonzero = nonzero || fraction[j] != 0;
+        }
+
+        decimals += (char)('0' + carry);
+        if (significant > 0 || carry > 0) ++significant;
+
+        if (!nonzero) break;
+    }
+
+    if (significant > digits) {
+        const bool round_up = decimals.back() >= '5';
+        decimals.pop_back();
+
+        for (long i = (long)decimals.size()-1; round_up && i >= -1; --i) {
+            if (i < 0) {
+                ++integer;
+            } else if (decimals[i] == '9') {
+                decimals[i] = '0';
+                continue;
+            } else {
+                ++decimals[i];
+            }
+            break;
+        }
+    }
+
+    std::stringstream ss;
+
+    if (_negative) ss << '-';
+    ss << integer;
+
+    size_t last = decimals.find_last_not_of('0');
+    if (last != string::npos) {
+        ss << '.' << decimals.substr(0, last+1);
+    }
+
+    return ss.str();
+}
@@ -0,0 +1,123 @@
+/******************************************************************************\
+ * This file is part of Micropolis.                                           *
+ *                                                                            *
+ * Micropolis is free software: you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation, either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * Micropolis is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with Micropolis.  If not, see <http://www.gnu.org/licenses/>.        *
+\******************************************************************************/
+
+
+#ifndef BIGFLOAT_H
+#define BIGFLOAT_H
+
+#include "common.h"
+
+#include <cstdint>
+
+/**
+ * Binary floating point number with an arbitrary, fixed mantissa length.
+ * The value is 0.m * 2^exponent with the mantissa m stored as 64-bit limbs,
+ * least significant first and normalized so the top bit is set. Results are
+ * truncated towards zero and take the larger precision of the operands.
+ */
+class BigFloat
+{
+    public:
+
+    typedef uint64_t limb;
+
+    static const int limb_bits = 64;
+
+    private:
+
+    vector<limb> _mantissa;
+    long _exponent;
+    bool _negative;
+
+    public:
+
+    /**
+     * Construct zero with a given precision.
+     * @param bits Mantissa length, rounded up to whole limbs.
+     */
+    explicit BigFloat(int bits = limb_bits);
+    BigFloat(double value, int bits);
+
+    int get_precision() const { return (int)_mantissa.size() * limb_bits; }
+
+    /**
+     * Change the mantissa length, truncating or zero-extending the value.
+     */
+    void set_precision(int bits);
+
+    bool is_zero() const { return _mantissa.back() == 0; }
+    bool is_negative() const { return _negative; }
+
+    /**
+     * Binary exponent e so that 2^(e-1) <= |value| < 2^e.
+     */
+    long get_exponent() const { return _exponent; }
+
+    double to_double() const;
+
+    /**
+     * Print in positional decimal notation.
+     * @param digits Significant digits. Zero picks enough for the precision.
+     */
+    string to_string(int digits = 0) const;
+
+    /**
+     * Parse decimal notation like "-1.25", "0.5e-20" or "3".
+     * @param s Input string.
+     * @param bits Minimum precision. Raised to hold all given digits.
+     * @param out Parsed value.
+     * @return false if s is not a valid number.
+     */
+    static bool parse(const string& s, int bits, BigFloat& out);
+
+    BigFloat operator- () const;
+
+    BigFloat& operator+= (const BigFloat& other);
+    BigFloat& operator-= (const BigFloat& other);
+    BigFloat& operator*= (const BigFloat& other);
+
+    /**
+     * Replace the value by its square, about twice as fast as multiplying it
+     * with itself.
+     */
+    BigFloat& square();
+
+    /**
+     * Multiply by 2^e.
+     */
+    BigFloat& mul_2exp(long e);
+
+    friend BigFloat operator+ (const BigFloat& a, const BigFloat& b);
+    friend BigFloat operator- (const BigFloat& a, const BigFloat& b);
+    friend BigFloat operator* (const BigFloat& a, const BigFloat& b);
+
+    /**
+     * Compare values, regardless of precision.
+     */
+    friend bool operator== (const BigFloat& a, const BigFloat& b);
+    friend bool operator!= (const BigFloat& a, const BigFloat& b) { return !(a == b); }
+
+    private:
+
+    void normalize(vector<limb>& m, long exponent, bool negative);
+
+    void add(const BigFloat& other, bool negate);
+    void mul_small(limb factor);
+    void div_small(limb divisor);
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include "utility.h"
 #include "Config.h"
 
+#include <cstring>
 #include <fstream>
     
 Statistics statistics;
@@ -30,6 +31,15 @@ Statistics::Statistics()
     , frames_per_second(0.0f)
     , ms_per_frame(0.0f)
     , opengl_memory(0)
+    , orbit_memory(0)
+    , skipped_iterations(0)
+    , glitched_pixels(0)
+    , reference_count(0)
+    , precision("")
+    , precision_switches(0)
+    , periodic_pixels(0)
+    , iterated_pixels(0)
+    , image_pixels(0)
 {
     _last_fps_calculation = nanotime();
 }
@@ -45,6 +55,76 @@ void Statistics::free_opengl_memory(long mem_size)
 }
 
 
+/**
+ * Orbit state both engines keep to raise the iteration limit.
+ */
+void Statistics::alloc_orbit_memory(long mem_size)
+{
+    orbit_memory += mem_size;
+}
+
+void Statistics::free_orbit_memory(long mem_size)
+{
+    orbit_memory -= mem_size;
+}
+
+
+void Statistics::skip_iterations(uint64_t count)
+{
+    skipped_iterations += count;
+}
+
+
+void Statistics::count_glitches(int pixels, int references)
+{
+    glitched_pixels = pixels;
+    reference_count = references;
+}
+
+
+/**
+ * Called by the CPU kernels from several threads for pixels that periodicity
+ * checking found inside the set.
+ */
+void Statistics::count_periodic(uint64_t pixels)
+{
+    if (pixels > 0) {
+        periodic_pixels += pixels;
+    }
+}
+
+
+/**
+ * Called per frame by renderers that fill part of the image without
+ * iterating it.
+ */
+void Statistics::count_iterated(uint64_t pixels, uint64_t total)
+{
+    iterated_pixels = pixels;
+    image_pixels = total;
+}
+
+
+/**
+ * Called for every frame with the arithmetic the renderer picked. Only
+ * changes are logged.
+ */
+void Statistics::set_precision(const char* name, double required_bits)
+{
+    if (strcmp(name, precision) == 0) return;
+
+    if (*precision) {
+        ++precision_switches;
+    }
+
+    if (config.verbosity_level() > 0) {
+        cout << "Switched to " << name << " arithmetic at " << required_bits << " required bits" << endl;
+    }
+
+    precision = name;
+}
+
+
 void Statistics::update()
 {
     ++_frames;
@@ -59,6 +139,9 @@ void Statistics::update()
         _frames = 0;
 
         print();
+
+        skipped_iterations = 0;
+        periodic_pixels = 0;
     }
 }
 
@@ -76,15 +159,54 @@ void Statistics::print()
              << ms_per_frame << " ms/frame, (" << frames_per_second  << " fps)" << endl;
         
         cout << memory_size(opengl_memory) << "allocated in OpenGL context" << endl;
+
+        if (orbit_memory > 0) {
+            cout << memory_size(orbit_memory) << "of orbit state kept for higher iteration limits" << endl;
+        }
+
+        print_render_counters();
     } else {
         cout  << ms_per_frame << " ms/frame, (" << frames_per_second  << " fps)" << endl;
     }
 }
 
 
+void Statistics::print_render_counters()
+{
+    if (*precision) {
+        cout << "Rendering in " << precision << " arithmetic, " << precision_switches << " switches" << endl;
+    }
+
+    if (skipped_iterations > 0) {
+        cout << skipped_iterations << " iterations skipped by series approximation" << endl;
+    }
+
+    if (periodic_pixels > 0) {
+        cout << periodic_pixels << " pixels stopped by periodicity checking" << endl;
+    }
+
+    if (image_pixels > 0) {
+        cout << 100.0 * iterated_pixels / image_pixels << "% of the pixels iterated in last frame, the rest filled" << endl;
+    }
+
+    if (reference_count > 0) {
+        cout << glitched_pixels << " glitched pixels, " << reference_count << " references in last frame" << endl;
+    }
+}
+
+
 void Statistics::dump_stats()
 {
     std::ofstream fs(config.statistics_file().c_str());
 
     fs << "opengl_mem = " << opengl_memory << ";" << endl;
+    fs << "orbit_mem = " << orbit_memory << ";" << endl;
+    fs << "skipped_iterations = " << skipped_iterations << ";" << endl;
+    fs << "glitched_pixels = " << glitched_pixels << ";" << endl;
+    fs << "reference_count = " << reference_count << ";" << endl;
+    fs << "periodic_pixels = " << periodic_pixels << ";" << endl;
+    fs << "iterated_pixels = " << iterated_pixels << ";" << endl;
+    fs << "image_pixels = " << image_pixels << ";" << endl;
+    fs << "precision = \"" << precision << "\";" << endl;
+    fs << "precision_switches = " << precision_switches << ";" << endl;
 }
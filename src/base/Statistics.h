@@ -21,6 +21,8 @@
 
 #include "common.h"
 
+#include <atomic>
+
 class Statistics
 {
     uint64_t _last_fps_calculation;
@@ -33,6 +35,15 @@ class Statistics
     float    frames_per_second;
     float    ms_per_frame;
     uint64_t opengl_memory;
+    uint64_t orbit_memory;
+    uint64_t skipped_iterations;
+    int      glitched_pixels;
+    int      reference_count;
+    const char* precision;
+    int      precision_switches;
+    std::atomic<uint64_t> periodic_pixels;
+    uint64_t iterated_pixels;
+    uint64_t image_pixels;
     
     public:
         
@@ -41,10 +52,20 @@ class Statistics
     void alloc_opengl_memory(long mem_size);
     void free_opengl_memory(long mem_size);
 
+    void alloc_orbit_memory(long mem_size);
+    void free_orbit_memory(long mem_size);
+
+    void skip_iterations(uint64_t count);
+    void count_glitches(int pixels, int references);
+    void set_precision(const char* name, double required_bits);
+    void count_periodic(uint64_t pixels);
+    void count_iterated(uint64_t pixels, uint64_t total);
+
     void update();
     void reset_timer();
 
     void print();
+    void print_render_counters();
     void dump_stats();
         
 };
@@ -0,0 +1,113 @@
+/******************************************************************************\
+ * This file is part of Micropolis.                                           *
+ *                                                                            *
+ * Micropolis is free software: you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation, either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * Micropolis is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with Micropolis.  If not, see <http://www.gnu.org/licenses/>.        *
+\******************************************************************************/
+
+
+#include "ThreadPool.h"
+
+
+ThreadPool::ThreadPool(int thread_count)
+    : _job(nullptr)
+    , _task_count(0)
+    , _next_task(0)
+    , _busy_threads(0)
+    , _generation(0)
+    , _shutdown(false)
+{
+    if (thread_count <= 0) {
+        thread_count = maximum(1, (int)std::thread::hardware_concurrency());
+    }
+
+    // The calling thread acts as the last worker.
+    for (int i = 0; i < thread_count-1; ++i) {
+        _threads.emplace_back(&ThreadPool::worker, this, i);
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shutdown = true;
+    }
+    _job_available.notify_all();
+
+    for (std::thread& thread : _threads) {
+        thread.join();
+    }
+}
+
+
+int ThreadPool::get_thread_count() const
+{
+    return (int)_threads.size() + 1;
+}
+
+
+void ThreadPool::run(size_t task_count, const Job& job)
+{
+    if (task_count == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = &job;
+        _task_count = task_count;
+        _next_task = 0;
+        _busy_threads = (int)_threads.size();
+        ++_generation;
+    }
+    _job_available.notify_all();
+
+    work((int)_threads.size());
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _job_finished.wait(lock, [this] { return _busy_threads == 0; });
+    _job = nullptr;
+}
+
+
+void ThreadPool::worker(int thread)
+{
+    long long generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _job_available.wait(lock, [&] { return _shutdown || _generation != generation; });
+
+            if (_shutdown) return;
+
+            generation = _generation;
+        }
+
+        work(thread);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            --_busy_threads;
+        }
+        _job_finished.notify_one();
+    }
+}
+
+
+void ThreadPool::work(int thread)
+{
+    for (size_t task = _next_task++; task < _task_count; task = _next_task++) {
+        (*_job)(task, thread);
+    }
+}
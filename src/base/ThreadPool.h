@@ -0,0 +1,85 @@
+/******************************************************************************\
+ * This file is part of Micropolis.                                           *
+ *                                                                            *
+ * Micropolis is free software: you can redistribute it and/or modify         *
+ * it under the terms of the GNU General Public License as published by       *
+ * the Free Software Foundation, either version 3 of the License, or          *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * Micropolis is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with Micropolis.  If not, see <http://www.gnu.org/licenses/>.        *
+\******************************************************************************/
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "common.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Fixed set of worker threads for data-parallel jobs.
+ * A job is split into independent tasks that the workers pull from a shared
+ * counter, so threads that finish cheap tasks early take over the rest.
+ */
+class ThreadPool : public noncopyable
+{
+    public:
+
+    /**
+     * Job callback.
+     * @param task Index of the task to process.
+     * @param thread Index of the executing thread in [0, thread count).
+     */
+    typedef std::function<void(size_t task, int thread)> Job;
+
+    private:
+
+    vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _job_available;
+    std::condition_variable _job_finished;
+
+    const Job* _job;
+    size_t _task_count;
+    std::atomic<size_t> _next_task;
+    int _busy_threads;
+    long long _generation;
+    bool _shutdown;
+
+    public:
+
+    /**
+     * Start the worker threads.
+     * @param thread_count Total number of threads including the caller.
+     *                     Zero or less uses one thread per hardware thread.
+     */
+    ThreadPool(int thread_count = 0);
+    ~ThreadPool();
+
+    int get_thread_count() const;
+
+    /**
+     * Execute job for each task in [0, task_count) and wait for completion.
+     * The calling thread works on the job as well.
+     */
+    void run(size_t task_count, const Job& job);
+
+    private:
+
+    void worker(int thread);
+    void work(int thread);
+};
+
+#endif
@@ -112,10 +112,8 @@ string read_file(const string &filename)
 
 
 
-void make_screenshot()
+bool save_image(const string& filename, int width, int height, unsigned char* rgb_data)
 {
-
-
     if (!Image::devil_initialized) {
         ilInit();
         ilEnable(IL_ORIGIN_SET);
@@ -123,6 +121,22 @@ void make_screenshot()
         Image::devil_initialized = true;
     }
 
+    ILuint il_image;
+    ilGenImages(1, &il_image);
+    ilBindImage(il_image);
+
+    ilTexImage(width, height, 0, 3, IL_RGB, IL_UNSIGNED_BYTE, rgb_data);
+
+    bool success = ilSave(IL_PNG, filename.c_str());
+
+    ilDeleteImages(1, &il_image);
+
+    return success;
+}
+
+
+void make_screenshot()
+{
     const string ssfn_start = "./screenshot";
     const string ssfn_end = ".png";
 
@@ -147,19 +161,12 @@ void make_screenshot()
     unsigned char *pixel_data = new unsigned char[viewport.width * viewport.height * 3];
     glReadPixels(viewport.x, viewport.y, viewport.width, viewport.height, GL_RGB, GL_UNSIGNED_BYTE, pixel_data);
 
-    ILuint il_image;
-    ilGenImages(1, &il_image);
-    ilBindImage(il_image);
-
-    ilTexImage(viewport.width, viewport.height, 0, 3, IL_RGB, IL_UNSIGNED_BYTE, pixel_data);
-    
-    if (ilSave(IL_PNG, filename.c_str())) {
+    if (save_image(filename, viewport.width, viewport.height, pixel_data)) {
         cout << "Successfully saved screenshot in file \"" << filename << "\"." << endl;
     } else {
         cout << "Failed saving screenshot in file \"" << filename << "\"." << endl;
     }
 
-    ilDeleteImages(1, &il_image);
     delete[] pixel_data;
 }
 
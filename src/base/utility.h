@@ -56,6 +56,14 @@ bool file_exists(const string &filename);
 
 void make_screenshot();
 
+/**
+ * Save 8-bit RGB pixel data to a PNG file.
+ * Rows are expected bottom to top, like data read from the framebuffer.
+ * @param filename Name of the file.
+ * @return True in case of success.
+ */
+bool save_image(const string& filename, int width, int height, unsigned char* rgb_data);
+
 /**
  * Read the content of a text file.
  * @param filename Name of the file.
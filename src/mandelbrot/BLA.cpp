@@ -0,0 +1,73 @@
+#include "BLA.h"
+
+
+// Relative size of the neglected delta^2 term, about the double epsilon.
+static const double bla_epsilon = 1.0 / (1ll << 53);
+
+
+BLATable::BLATable()
+    : reference_id(0)
+    , dc_radius(0.0)
+{
+}
+
+
+void BLATable::compute(const ReferenceOrbit& Z, const floatexp& dc_radius)
+{
+    // Radii shrink with dc_radius, so rebuild when it got much smaller, too.
+    if (Z.get_id() == reference_id && dc_radius <= this->dc_radius && dc_radius * 4.0 > this->dc_radius) {
+        return;
+    }
+
+    reference_id = Z.get_id();
+    this->dc_radius = dc_radius;
+
+    steps.clear();
+    level_offsets.clear();
+
+    const int length = Z.length();
+
+    if (length <= 0) {
+        return;
+    }
+
+    // delta' = 2 Z delta + delta^2 + delta_c ~ 2 Z delta + delta_c
+    // while |delta^2| is negligible against |2 Z delta|.
+    level_offsets.push_back(0);
+
+    for (int n = 0; n < length; ++n) {
+        BLAStep step;
+        step.a = 2.0 * Z[n];
+        step.b = dvec2(1,0);
+        step.radius = bla_epsilon * glm::length(step.a);
+        step.padding = 0;
+
+        steps.push_back(step);
+    }
+
+    // Step y after step x: a = a_y a_x, b = a_y b_x + b_y. The radius of y
+    // must hold for every delta that x can produce.
+    int count = length;
+
+    while (count > 1) {
+        const int source = level_offsets.back();
+        count /= 2;
+
+        level_offsets.push_back((int)steps.size());
+
+        for (int i = 0; i < count; ++i) {
+            const BLAStep x = steps[source + 2*i];
+            const BLAStep y = steps[source + 2*i + 1];
+
+            BLAStep step;
+            step.a = cmul(y.a, x.a);
+            step.b = cmul(y.a, x.b) + y.b;
+            const double b_dc = (dc_radius * glm::length(x.b)).to_double();
+
+            step.radius = minimum(x.radius, maximum(0.0, (y.radius - b_dc) / glm::length(x.a)));
+            step.padding = 0;
+
+            steps.push_back(step);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "common.h"
+
+#include "Perturbation.h"
+
+
+/**
+ * One merged run of perturbation steps: delta_{n+l} = a delta_n + b delta_c.
+ * Valid while |delta_n| < radius. Laid out like the std430 struct in
+ * perturbation.frag.
+ */
+struct BLAStep
+{
+    dvec2 a;
+    dvec2 b;
+    double radius;
+    double padding;
+};
+
+
+/**
+ * Bilinear approximation table of a reference orbit.
+ * Level 0 holds the single steps n -> n+1, level k the merged steps
+ * i*2^k -> (i+1)*2^k. A pixel at iteration n takes the largest step of a
+ * level that n is aligned to and whose radius its delta fits into.
+ */
+class BLATable
+{
+    vector<BLAStep> steps;
+    vector<int> level_offsets;
+
+    int reference_id;
+    floatexp dc_radius;
+
+    public:
+
+    BLATable();
+
+    /**
+     * Build the table for all pixels with |delta_c| <= dc_radius.
+     * A table built for the same reference and a somewhat larger radius is
+     * still valid and kept.
+     */
+    void compute(const ReferenceOrbit& reference, const floatexp& dc_radius);
+
+    int get_levels() const { return (int)level_offsets.size(); }
+    int get_size() const { return (int)steps.size(); }
+    const BLAStep* get_data() const { return steps.data(); }
+
+    /**
+     * Find the largest valid step starting at iteration n.
+     * @return Number of iterations skipped, 0 if no step applies.
+     */
+    int lookup(int n, const dvec2& delta, const BLAStep*& step) const
+    {
+        const int single_count = get_levels() > 1 ? level_offsets[1] : get_size();
+        if (n <= 0 || n >= single_count) return 0;
+
+        const double delta2 = glm::dot(delta, delta);
+
+        // Merged steps are never valid for more than their first single step.
+        const BLAStep& single = steps[n];
+        if (!(delta2 < single.radius * single.radius)) return 0;
+
+        for (int level = minimum(__builtin_ctz(n), get_levels() - 1); level > 0; --level) {
+            const int index = level_offsets[level] + (n >> level);
+            const int end = level + 1 < get_levels() ? level_offsets[level + 1] : get_size();
+
+            if (index >= end) continue;
+
+            if (delta2 < steps[index].radius * steps[index].radius) {
+                step = &steps[index];
+                return 1 << level;
+            }
+        }
+
+        step = &single;
+        return 1;
+    }
+};
@@ -0,0 +1,116 @@
+#include "CPUMandelbrot.h"
+
+CPUMandelbrot::CPUMandelbrot()
+    : rendered_view(dvec2(0,0), 0.0, ivec2(0,0), 0)
+    , keep_orbits(false)
+    , depth(0)
+    , continued_from(0)
+{
+}
+
+
+void CPUMandelbrot::draw(const View& view)
+{
+    const bool new_reference = renderer.has_new_reference(view);
+
+    // Rendering is expensive, only redo it for a new view or reference.
+    if (view != rendered_view || new_reference) {
+        ivec2 shift;
+        double scale;
+        dvec2 offset;
+
+        // A running continuation leaves an image complete at the limit it started from
+        const bool complete = !new_reference && (schedule.is_done() || continued_from > 0);
+
+        if (complete && keep_orbits && view.has_same_pixels(rendered_view) && view.max_iterations >= rendered_view.max_iterations) {
+            // A higher limit only continues the pixels that reached the last one
+            if (view.max_iterations > depth) {
+                deepen(view.size, view.max_iterations);
+            }
+        } else if (complete && view.get_shift(rendered_view, shift)) {
+            // A pan only needs the strips it uncovered. A running
+            // continuation is dropped, the strips get the limit it started
+            // from and the whole image catches up once they are done.
+            if (continued_from > 0) {
+                depth = continued_from;
+                continued_from = 0;
+            }
+
+            buffer.shift(shift);
+            if (keep_orbits) orbits.shift(shift);
+            colorizer.shift_iterations(shift);
+            schedule.start(view.size, get_exposed_tiles(view.size, shift), maximum(config.tile_size(), 1));
+        } else {
+            // Other views show the last image until their tiles are done
+            if (view.get_reprojection(rendered_view, scale, offset)) {
+                colorizer.start_preview(scale, offset);
+            } else {
+                colorizer.clear_preview();
+            }
+
+            buffer.resize(view.size);
+            buffer.clear();
+            schedule.start_progressive(view.size, maximum(config.tile_size(), 1));
+
+            keep_orbits = config.keep_orbits() && renderer.saves_orbits(view);
+            depth = view.max_iterations;
+            continued_from = 0;
+
+            if (keep_orbits) orbits.resize(view.size);
+        }
+
+        rendered_view = view;
+    }
+
+    // Finished views catch up with their limit, then keep getting deeper
+    // while nothing else is to do
+    if (schedule.is_done() && keep_orbits && depth > 0) {
+        if (depth < view.max_iterations) {
+            deepen(view.size, view.max_iterations);
+        } else if (depth < config.deepen_limit()) {
+            deepen(view.size, minimum(2 * depth, config.deepen_limit()));
+        }
+    }
+
+    if (!schedule.is_done()) {
+        const Batch batch = schedule.next();
+
+        View target(view);
+        target.max_iterations = depth;
+
+        uint64_t start = nanotime();
+
+        if (continued_from > 0) {
+            renderer.continue_orbits(target, continued_from, buffer, orbits, batch.tiles);
+        } else if (batch.pass.step == 1) {
+            renderer.render(target, buffer, batch.tiles, keep_orbits ? &orbits : NULL);
+        } else {
+            renderer.render_lattice(target, batch.pass.step, batch.pass.phase, lattice, batch.tiles, keep_orbits ? &lattice_orbits : NULL);
+            fill_blocks(batch.pass, lattice, batch.tiles, buffer);
+
+            if (keep_orbits) copy_orbits(batch.pass, lattice_orbits, batch.tiles, orbits);
+        }
+
+        schedule.finished(batch, (nanotime() - start) / (double)MILLION);
+
+        if (schedule.is_done()) {
+            continued_from = 0;
+        }
+
+        colorizer.get_iterations(view.size).load(buffer.get_data());
+    }
+
+    colorizer.draw();
+}
+
+
+void CPUMandelbrot::deepen(const ivec2& size, int iterations)
+{
+    // Pixels a running continuation already passed resume from their new orbit point
+    if (continued_from == 0) {
+        continued_from = depth;
+    }
+
+    depth = iterations;
+    schedule.start_continuation(size, maximum(config.tile_size(), 1));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common.h"
+
+#include "Config.h"
+
+#include "CPURenderer.h"
+#include "Colorizer.h"
+#include "IterationBuffer.h"
+#include "OrbitBuffer.h"
+#include "TileSchedule.h"
+#include "View.h"
+
+
+/**
+ * Displays the output of the CPU engine in the GL window.
+ * The iteration buffer is uploaded to the iteration texture of the
+ * colorizer shared with the GLSL renderer. Slow views are rendered over
+ * several frames and optionally in coarse passes first, see TileSchedule.
+ *
+ * In double precision the orbit points of the pixels that reach the
+ * iteration limit are kept. A higher limit for the same pixels, and the
+ * deepening of finished views up to config.deepen_limit(), only continue
+ * those, also over several frames.
+ */
+class CPUMandelbrot
+{
+
+    CPURenderer renderer;
+    IterationBuffer buffer;
+    IterationBuffer lattice;    /**< Pixels of a coarse pass. */
+    OrbitBuffer orbits;
+    OrbitBuffer lattice_orbits;
+    View rendered_view;
+    bool keep_orbits;           /**< rendered_view saves orbits. */
+    int depth;                  /**< Iteration limit of buffer, may be above the one of rendered_view. */
+    int continued_from;         /**< Limit the scheduled tiles are continued from, 0 if they are rendered. */
+    Colorizer colorizer;
+    TileSchedule schedule;
+    
+    public:
+
+    CPUMandelbrot();
+    
+    void draw(const View& view);
+
+    bool is_refining() const { return renderer.is_refining(); }
+
+    /**
+     * True while tiles of the current view are still to be iterated.
+     */
+    bool is_incomplete() const { return !schedule.is_done(); }
+
+    private:
+
+    /**
+     * Continue the pixels that reached the current limit up to a higher one.
+     */
+    void deepen(const ivec2& size, int iterations);
+};
@@ -0,0 +1,360 @@
+#include "CPURenderer.h"
+
+#include "Statistics.h"
+
+#include <atomic>
+
+
+/**
+ * Julia sets are connected if the orbit of z=0 stays bounded, c lies in the
+ * Mandelbrot set then.
+ */
+static bool is_connected_julia(const dvec2& c, int max_iterations)
+{
+    dvec2 z(0,0);
+
+    for (int i = 0; i < max_iterations; ++i) {
+        if (glm::dot(z, z) >= 4.0) return false;
+        z = dvec2(z.x * z.x - z.y * z.y, 2 * z.x * z.y) + c;
+    }
+
+    return true;
+}
+
+
+CPURenderer::CPURenderer()
+    : pool(config.thread_count())
+    , tile_size(maximum(config.tile_size(), 1))
+    , kernels(select_kernel_variant(config.cpu_kernel()))
+    , kernel(config.lane_refill() ? kernels.escape_time_refill : kernels.escape_time)
+    , ladder({ PRECISION_DOUBLE, PRECISION_LONG_DOUBLE, PRECISION_FIXED128, PRECISION_FLOAT128, PRECISION_PERTURBATION })
+{
+    if (config.verbosity_level() > 0) {
+        cout << "Using " << kernels.name << " CPU kernels on " << pool.get_thread_count() << " threads" << endl;
+    }
+}
+
+
+CPURenderer::~CPURenderer()
+{
+}
+
+
+void CPURenderer::render(const View& view, IterationBuffer& buffer)
+{
+    render(view, buffer, { { 0, 0, view.size.x, view.size.y } });
+}
+
+
+void CPURenderer::render(const View& view, IterationBuffer& buffer, const vector<Tile>& regions, OrbitBuffer* orbits)
+{
+    this->regions = regions;
+    lattice = Lattice();
+
+    render_view(view, buffer, orbits);
+}
+
+
+void CPURenderer::render_lattice(const View& view, int step, const ivec2& phase, IterationBuffer& buffer, const vector<Tile>& regions, OrbitBuffer* orbits)
+{
+    this->regions = regions;
+    lattice = Lattice(step, phase);
+
+    render_view(view, buffer, orbits);
+}
+
+
+bool CPURenderer::saves_orbits(const View& view)
+{
+    return ladder.select(view) == PRECISION_DOUBLE;
+}
+
+
+void CPURenderer::continue_orbits(const View& view, int from, IterationBuffer& buffer, OrbitBuffer& orbits, const vector<Tile>& regions)
+{
+    this->regions = regions;
+    lattice = Lattice();
+
+    KernelArgs args;
+    args.origin = view.pixel_center(0,0);
+    args.step = view.pixel_spacing().to_double();
+    args.max_iterations = view.max_iterations;
+    args.julia = false;
+    args.c = dvec2(0,0);
+    args.periodicity_check = config.periodicity_check();
+    args.periodicity_tolerance = args.step * periodicity_tolerance_pixels;
+    args.orbits = &orbits;
+    args.continue_from = from;
+
+    // Only the refill kernels load lanes from saved orbit points
+    SubdivisionArgs subdivision;
+    subdivision.render = [&](const Tile& tile) { kernels.escape_time_refill(args, tile, buffer); };
+    subdivision.connected = true;
+
+    render_tiles(subdivision, buffer);
+}
+
+
+void CPURenderer::render_view(const View& view, IterationBuffer& buffer, OrbitBuffer* orbits)
+{
+    KernelArgs args;
+    args.origin = view.pixel_center(0,0);
+    args.step = view.pixel_spacing().to_double();
+    args.max_iterations = view.max_iterations;
+    args.lattice = lattice;
+    args.julia = false;
+    args.c = dvec2(0,0);
+    args.periodicity_check = config.periodicity_check();
+    args.periodicity_tolerance = args.step * periodicity_tolerance_pixels;
+    args.orbits = NULL;
+    args.continue_from = 0;
+
+    const Precision precision = ladder.select(view);
+
+    if (precision == PRECISION_DOUBLE && orbits) {
+        // Pixels the kernels don't reach, like filled ones, start over
+        orbits->resize(lattice.get_size(view.size));
+
+        for (const Tile& region : regions) {
+            orbits->clear(region);
+        }
+
+        args.orbits = orbits;
+    }
+
+    if (precision == PRECISION_DOUBLE && config.exterior_fill()) {
+        render_filled(view, args, buffer);
+    } else if (precision == PRECISION_DOUBLE) {
+        render_direct(view, args, kernel, buffer);
+    } else if (precision == PRECISION_LONG_DOUBLE || precision == PRECISION_FLOAT128) {
+        const dvec2 offset = view.pixel_offset(0,0).to_dvec2();
+
+        args.wide_origin_re = to_float128(view.center_re) + offset.x;
+        args.wide_origin_im = to_float128(view.center_im) + offset.y;
+        args.wide_step = args.step;
+
+        render_direct(view, args, precision == PRECISION_LONG_DOUBLE ? long_double_kernel : float128_kernel, buffer);
+    } else if (precision == PRECISION_FIXED128) {
+        const dvec2 offset = view.pixel_offset(0,0).to_dvec2();
+
+        args.fixed_origin_re = to_fixed(view.center_re) + to_fixed(offset.x);
+        args.fixed_origin_im = to_fixed(view.center_im) + to_fixed(offset.y);
+        args.fixed_step = to_fixed(args.step);
+
+        render_direct(view, args, fixed128_kernel, buffer);
+    } else {
+        render_perturbation(view, buffer);
+    }
+}
+
+
+void CPURenderer::render_julia(const View& view, const dvec2& c, IterationBuffer& buffer)
+{
+    regions = { { 0, 0, view.size.x, view.size.y } };
+    lattice = Lattice();
+
+    KernelArgs args;
+    args.origin = view.pixel_center(0,0);
+    args.step = view.pixel_spacing().to_double();
+    args.max_iterations = view.max_iterations;
+    args.julia = true;
+    args.c = c;
+    args.periodicity_check = config.periodicity_check();
+    args.periodicity_tolerance = args.step * periodicity_tolerance_pixels;
+    args.orbits = NULL;
+    args.continue_from = 0;
+
+    render_direct(view, args, kernel, buffer);
+}
+
+
+void CPURenderer::render_direct(const View& view, const KernelArgs& args, TileKernel tile_kernel, IterationBuffer& buffer)
+{
+    buffer.resize(lattice.get_size(view.size));
+
+    SubdivisionArgs subdivision;
+    subdivision.render = [&](const Tile& tile) { tile_kernel(args, tile, buffer); };
+    subdivision.connected = !args.julia || is_connected_julia(args.c, args.max_iterations);
+
+    render_tiles(subdivision, buffer);
+}
+
+
+void CPURenderer::render_filled(const View& view, const KernelArgs& args, IterationBuffer& buffer)
+{
+    buffer.resize(lattice.get_size(view.size));
+
+    std::atomic<uint64_t> iterated(0);
+
+    for_each_tile([&](const Tile& tile, int thread) {
+            iterated += render_exterior_filled(args, kernel, tile, buffer);
+        });
+
+    statistics.count_iterated(iterated, get_region_pixels());
+}
+
+
+void CPURenderer::render_perturbation(const View& view, IterationBuffer& buffer)
+{
+    std::shared_ptr<const ReferenceOrbit> reference = references.get(view);
+
+    const vector<floatexp2> corners = get_corner_offsets(view, *reference);
+
+    series.compute(*reference, get_probe_offsets(view, *reference), config.series_terms(), config.series_tolerance());
+
+    statistics.skip_iterations((uint64_t)series.get_skip() * get_region_pixels());
+
+    if (config.bla()) {
+        bla.compute(*reference, get_max_offset(corners));
+    }
+
+    PerturbationArgs args;
+    args.reference = reference.get();
+    args.series = &series;
+    args.bla = config.bla() ? &bla : NULL;
+    args.offset = corners[0];
+    args.step = view.pixel_spacing();
+    args.max_iterations = view.max_iterations;
+    args.lattice = lattice;
+    args.periodicity_check = config.periodicity_check();
+    args.periodicity_tolerance = (args.step * periodicity_tolerance_pixels).to_double();
+    args.glitches = &glitches;
+    args.glitched_only = false;
+
+    buffer.resize(lattice.get_size(view.size));
+    glitches.reset(lattice.get_size(view.size));
+
+    SubdivisionArgs subdivision;
+    subdivision.render = [&](const Tile& tile) { perturbation_kernel(args, tile, buffer); };
+    subdivision.connected = true;
+
+    render_tiles(subdivision, buffer);
+
+    correct_glitches(view, buffer);
+    suggest_reference(view, buffer);
+}
+
+
+/**
+ * The pixel with the most iterations has the longest orbit, so the fewest
+ * pixels outlive it as a reference.
+ */
+void CPURenderer::suggest_reference(const View& view, const IterationBuffer& buffer)
+{
+    const ivec2 size = buffer.get_size();
+
+    ivec2 best(size / 2);
+    float best_iterations = -1.0f;
+
+    for (int y = 0; y < size.y; ++y) {
+        const Pixel* row = buffer.row(y);
+
+        for (int x = 0; x < size.x; ++x) {
+            if (!row[x].has(PIXEL_NOT_ITERATED) && row[x].count > best_iterations) {
+                best_iterations = row[x].count;
+                best = ivec2(x, y);
+            }
+        }
+    }
+
+    const ivec2 pixel = lattice.get_pixel(best.x, best.y);
+    const floatexp2 offset = view.pixel_offset(pixel.x, pixel.y);
+
+    references.suggest(view.center_re + offset.x().to_bigfloat(BigFloat::limb_bits),
+                       view.center_im + offset.y().to_bigfloat(BigFloat::limb_bits));
+}
+
+
+void CPURenderer::render_tiles(const SubdivisionArgs& subdivision, IterationBuffer& buffer)
+{
+    if (!config.subdivision()) {
+        for_each_tile([&](const Tile& tile, int thread) {
+                subdivision.render(tile);
+            });
+        return;
+    }
+
+    std::atomic<uint64_t> iterated(0);
+
+    for_each_tile([&](const Tile& tile, int thread) {
+            iterated += render_subdivided(subdivision, tile, buffer);
+        });
+
+    statistics.count_iterated(iterated, get_region_pixels());
+}
+
+
+void CPURenderer::correct_glitches(const View& view, IterationBuffer& buffer)
+{
+    const int glitched = glitches.count();
+    int references = 1;
+
+    ivec2 glitched_pixel;
+
+    while (references < config.max_references() && glitches.find_reference(glitched_pixel)) {
+        // The new reference is exact, only its distance to the pixels is rounded.
+        const ivec2 pixel = lattice.get_pixel(glitched_pixel.x, glitched_pixel.y);
+        const floatexp2 offset = view.pixel_offset(pixel.x, pixel.y);
+
+        BigFloat re = view.center_re + offset.x().to_bigfloat(BigFloat::limb_bits);
+        BigFloat im = view.center_im + offset.y().to_bigfloat(BigFloat::limb_bits);
+
+        glitch_reference.compute(re, im, view.max_iterations, view.get_precision());
+        references++;
+
+        PerturbationArgs args;
+        args.reference = &glitch_reference;
+        args.series = NULL;
+        args.bla = NULL;
+        args.offset = view.pixel_offset(0,0) - offset;
+        args.step = view.pixel_spacing();
+        args.max_iterations = view.max_iterations;
+        args.lattice = lattice;
+        args.periodicity_check = config.periodicity_check();
+        args.periodicity_tolerance = (args.step * periodicity_tolerance_pixels).to_double();
+        args.glitches = &glitches;
+        args.glitched_only = true;
+
+        if (config.bla()) {
+            glitch_bla.compute(glitch_reference, args.offset.length() + args.step * glm::length(dvec2(view.size)));
+            args.bla = &glitch_bla;
+        }
+
+        for_each_tile([&](const Tile& tile, int thread) {
+                perturbation_kernel(args, tile, buffer);
+            });
+    }
+
+    statistics.count_glitches(glitched, references);
+}
+
+
+uint64_t CPURenderer::get_region_pixels() const
+{
+    uint64_t pixels = 0;
+
+    for (const Tile& region : regions) {
+        pixels += (uint64_t)region.w * region.h;
+    }
+
+    return pixels;
+}
+
+
+void CPURenderer::for_each_tile(const std::function<void(const Tile& tile, int thread)>& job)
+{
+    // Tiles of each region start at its lower left corner
+    vector<Tile> tiles;
+
+    for (const Tile& region : regions) {
+        for (int y = 0; y < region.h; y += tile_size) {
+            for (int x = 0; x < region.w; x += tile_size) {
+                tiles.push_back({ region.x + x, region.y + y, minimum(tile_size, region.w - x), minimum(tile_size, region.h - y) });
+            }
+        }
+    }
+
+    pool.run(tiles.size(), [&](size_t task, int thread) {
+            job(tiles[task], thread);
+        });
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "common.h"
+
+#include "Config.h"
+#include "ThreadPool.h"
+
+#include "IterationBuffer.h"
+#include "Kernel.h"
+#include "OrbitBuffer.h"
+#include "BLA.h"
+#include "ExteriorFill.h"
+#include "Perturbation.h"
+#include "Precision.h"
+#include "ReferenceCache.h"
+#include "Subdivision.h"
+#include "View.h"
+
+#include <functional>
+
+
+/**
+ * Renders the Mandelbrot set on the CPU.
+ * The image is cut into square tiles which the thread pool processes in
+ * parallel. Tiles are handed out dynamically, so expensive tiles near the set
+ * don't leave other threads idle. Once doubles can't resolve the pixel
+ * spacing the tiles are rendered relative to a reference orbit through the
+ * view center, with glitched pixels redone from additional references, or
+ * optionally by a 128-bit fixed point kernel down to the depths it can
+ * resolve. Optionally tiles are rendered by Mariani-Silver subdivision,
+ * which fills interior rectangles from their borders, or shallow
+ * views fill the exterior from distance estimates. In double precision the
+ * orbit points of the pixels that reach the iteration limit can be kept, so
+ * a higher limit only continues those.
+ */
+class CPURenderer : public noncopyable
+{
+    ThreadPool pool;
+    int tile_size;
+
+    const KernelVariant& kernels;
+    TileKernel kernel;
+
+    PrecisionLadder ladder;
+    ReferenceCache references;
+    SeriesApproximation series;
+    BLATable bla;
+
+    GlitchMap glitches;
+    ReferenceOrbit glitch_reference;
+    BLATable glitch_bla;
+
+    vector<Tile> regions;   /**< Parts of the buffer the current render iterates. */
+    Lattice lattice;        /**< Image pixels the buffer of the current render holds. */
+
+    public:
+
+    CPURenderer();
+    ~CPURenderer();
+
+    int get_thread_count() const { return pool.get_thread_count(); }
+
+    /**
+     * True while a better reference orbit is computed in the background.
+     */
+    bool is_refining() const { return references.is_pending(); }
+
+    /**
+     * True if rendering the same view again would give a better result.
+     * A reference that finished after zooming out of perturbation waits
+     * for the next view that needs it.
+     */
+    bool has_new_reference(const View& view) const { return references.is_ready() && uses_reference(ladder.select(view)); }
+    const char* get_kernel_name() const { return kernels.name; }
+
+    /**
+     * Arithmetic this engine can render with, cheapest first.
+     */
+    const vector<Precision>& get_precision_tiers() const { return ladder.get_tiers(); }
+
+    void render(const View& view, IterationBuffer& buffer);
+
+    /**
+     * Render only some parts of the image, the rest of buffer is kept.
+     * Used for the strips a pan uncovers.
+     * @param orbits Receives the orbit points of the regions if
+     *               saves_orbits(view), may be NULL.
+     */
+    void render(const View& view, IterationBuffer& buffer, const vector<Tile>& regions, OrbitBuffer* orbits = NULL);
+
+    /**
+     * Render the pixels phase + (i,j) * step of view as pixels (i,j) of
+     * buffer, only in the regions. They get the same coordinates, precision,
+     * reference orbit and series as in a full render of view, so finer
+     * passes can keep them. Only exterior fill, which fills other squares,
+     * and the extra references for glitched pixels may give other counts.
+     */
+    void render_lattice(const View& view, int step, const ivec2& phase, IterationBuffer& buffer, const vector<Tile>& regions, OrbitBuffer* orbits = NULL);
+
+    /**
+     * True if render() keeps the orbit points of view, which only the double
+     * precision kernels do.
+     */
+    bool saves_orbits(const View& view);
+
+    /**
+     * Raise the iteration limit of the regions of an image rendered with
+     * saves_orbits() to view.max_iterations. Only pixels that reached from
+     * are continued, with subdivision only those on the borders of
+     * rectangles that don't stay uniform.
+     */
+    void continue_orbits(const View& view, int from, IterationBuffer& buffer, OrbitBuffer& orbits, const vector<Tile>& regions);
+
+    /**
+     * Render the Julia set for constant c instead of the Mandelbrot set.
+     */
+    void render_julia(const View& view, const dvec2& c, IterationBuffer& buffer);
+
+    private:
+
+    /**
+     * Render the lattice pixels of view in the regions.
+     */
+    void render_view(const View& view, IterationBuffer& buffer, OrbitBuffer* orbits);
+    void render_direct(const View& view, const KernelArgs& args, TileKernel tile_kernel, IterationBuffer& buffer);
+    void render_filled(const View& view, const KernelArgs& args, IterationBuffer& buffer);
+    void render_perturbation(const View& view, IterationBuffer& buffer);
+    void render_tiles(const SubdivisionArgs& subdivision, IterationBuffer& buffer);
+    void correct_glitches(const View& view, IterationBuffer& buffer);
+    void suggest_reference(const View& view, const IterationBuffer& buffer);
+
+    uint64_t get_region_pixels() const;
+
+    /**
+     * Cut the regions into tiles and process them on the thread pool.
+     */
+    void for_each_tile(const std::function<void(const Tile& tile, int thread)>& job);
+};
@@ -0,0 +1,145 @@
+#include "Colorizer.h"
+
+
+/**
+ * Make texture an iteration texture of the given size, its contents are
+ * undefined if it had to be replaced.
+ */
+static void fit_iterations(GL::Texture*& texture, const ivec2& size)
+{
+    if (!texture || texture->width() != size.x || texture->height() != size.y) {
+        delete texture;
+        texture = new GL::Texture(2,size.x,size.y,0,GL_RG,GL_RG32F,GL_NEAREST,GL_NEAREST,GL_CLAMP_TO_EDGE);
+    }
+}
+
+
+Colorizer::Colorizer()
+    : shader("colorize")
+    , quad(4)
+    , iterations(nullptr)
+    , scratch(nullptr)
+    , preview(nullptr)
+    , has_preview(false)
+    , preview_scale(1.0)
+    , preview_offset(0,0)
+{
+    quad.vertex(-1,-1);
+    quad.vertex( 1,-1);
+    quad.vertex(-1, 1);
+    quad.vertex( 1, 1);
+    quad.send_data(false);
+
+    const int W = 256*4;
+    GLfloat texdata[W];
+    for (int i=0; i < W; ++i) {
+        double x = i/double(W) * M_PI * 2.0;
+        texdata[i] = float(sin(x) * 0.5 + 0.5);
+    }
+
+    palette = new GL::Texture(1,W,0,0,GL_RED,GL_R32F,GL_LINEAR,GL_LINEAR_MIPMAP_LINEAR,GL_REPEAT,0,texdata);
+}
+
+
+Colorizer::~Colorizer()
+{
+    delete preview;
+    delete scratch;
+    delete iterations;
+    delete palette;
+}
+
+
+GL::Texture& Colorizer::get_iterations(const ivec2& size)
+{
+    fit_iterations(iterations, size);
+
+    return *iterations;
+}
+
+
+void Colorizer::clear_iterations(const ivec2& size)
+{
+    framebuffer.attach(get_iterations(size));
+    framebuffer.bind();
+    const GLfloat value[4] = { not_iterated.count, not_iterated.flags, 0, 0 };
+
+    glClearBufferfv(GL_COLOR, 0, value);
+    framebuffer.unbind();
+}
+
+
+void Colorizer::shift_iterations(const ivec2& shift)
+{
+    const ivec2 size(iterations->width(), iterations->height());
+
+    // Copies between overlapping parts of one texture are undefined
+    std::swap(iterations, scratch);
+    clear_iterations(size);
+
+    preview_offset += dvec2(shift) * preview_scale;
+
+    const int w = size.x - abs(shift.x);
+    const int h = size.y - abs(shift.y);
+
+    if (w <= 0 || h <= 0) return;
+
+    glCopyImageSubData(scratch->texture_name(), GL_TEXTURE_2D, 0, maximum(shift.x, 0), maximum(shift.y, 0), 0,
+                       iterations->texture_name(), GL_TEXTURE_2D, 0, maximum(-shift.x, 0), maximum(-shift.y, 0), 0,
+                       w, h, 1);
+}
+
+
+void Colorizer::start_preview(double scale, const dvec2& offset)
+{
+    if (!iterations) return;
+
+    const ivec2 size(iterations->width(), iterations->height());
+
+    fit_iterations(scratch, size);
+
+    framebuffer.attach(*scratch);
+    framebuffer.bind();
+    draw_pass(true);
+    framebuffer.unbind();
+
+    std::swap(preview, scratch);
+
+    has_preview = true;
+    preview_scale = scale;
+    preview_offset = offset;
+}
+
+
+void Colorizer::draw()
+{
+    draw_pass(false);
+}
+
+
+void Colorizer::draw_pass(bool resolve)
+{
+    palette->bind();
+    iterations->bind();
+    if (has_preview) preview->bind();
+    shader.bind();
+
+    shader.set_uniform("palette_offset", (GLfloat)config.palette_offset());
+    shader.set_uniform("tex", (const GL::Tex*)palette);
+    shader.set_uniform("iterations", (const GL::Tex*)iterations);
+    shader.set_uniform("resolve", (GLint)resolve);
+    shader.set_uniform("has_preview", (GLint)has_preview);
+
+    if (has_preview) {
+        shader.set_uniform("preview", (const GL::Tex*)preview);
+        shader.set_uniform("preview_scale", (GLfloat)preview_scale);
+        shader.set_uniform("preview_offset", vec2(preview_offset));
+    }
+    
+    quad.draw(GL_TRIANGLE_STRIP, shader);
+        
+    shader.unbind();
+    if (has_preview) preview->unbind();
+    iterations->unbind();
+    palette->unbind();
+}
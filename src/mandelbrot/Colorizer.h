@@ -0,0 +1,85 @@
+#pragma once
+
+#include "common.h"
+
+#include "Config.h"
+
+#include "GL/Framebuffer.h"
+#include "GL/Shader.h"
+#include "GL/Texture.h"
+#include "GL/VBO.h"
+
+#include "IterationBuffer.h"
+
+
+/**
+ * Colors the iteration counts of either engine in the window.
+ * Both fill the same RG32F texture with the layout of IterationBuffer, the
+ * smooth count and the PixelFlags of each pixel. The CPU engine uploads its
+ * buffer, the GL engine renders into the texture. Repaints and palette
+ * changes only run the coloring pass, one texel fetch per pixel.
+ *
+ * Pixels not iterated yet show the preview instead, the image of an earlier
+ * view mapped onto the current one.
+ */
+class Colorizer : public noncopyable
+{
+    GL::Shader shader;
+    GL::VBO quad;
+    GL::Framebuffer framebuffer;
+    GL::Texture* palette;
+    GL::Texture* iterations;
+    GL::Texture* scratch;   /**< Target of shifts and previews, swapped with the others. */
+    GL::Texture* preview;
+
+    bool has_preview;
+    double preview_scale;   /**< Maps pixels of iterations to preview, see View::get_reprojection(). */
+    dvec2 preview_offset;
+
+    public:
+
+    Colorizer();
+    ~Colorizer();
+
+    /**
+     * Iteration texture of the given size. A new one with undefined
+     * contents replaces the old one if the size changed.
+     */
+    GL::Texture& get_iterations(const ivec2& size);
+
+    /**
+     * Mark all pixels of the iteration texture as not iterated.
+     */
+    void clear_iterations(const ivec2& size);
+
+    /**
+     * Move the iteration texture contents like IterationBuffer::shift(),
+     * uncovered pixels are not iterated. The texture returned by
+     * get_iterations() changes.
+     */
+    void shift_iterations(const ivec2& shift);
+
+    /**
+     * Keep the current image, with its own preview filled in, as preview
+     * for a new view. scale and offset map pixels of the new view to it.
+     */
+    void start_preview(double scale, const dvec2& offset);
+
+    /**
+     * Show pixels not iterated yet in black.
+     */
+    void clear_preview() { has_preview = false; }
+
+    /**
+     * Color the iteration texture with the palette shifted by the config
+     * option palette_offset.
+     */
+    void draw();
+
+    private:
+
+    /**
+     * @param resolve Write the counts with the preview filled in instead of colors.
+     */
+    void draw_pass(bool resolve);
+};
@@ -0,0 +1,217 @@
+#include "ExteriorFill.h"
+
+#include <limits>
+
+
+/**
+ * Squares below this edge length are left to the kernel.
+ */
+static const int min_fill_size = 8;
+
+/**
+ * The distance estimate assumes log|z| / 2^n has converged to the Green's
+ * function, so centers are iterated on to a large radius.
+ */
+static const double estimate_radius = 1e10;
+
+
+/**
+ * Orbit of one square center.
+ */
+struct DistanceEstimate
+{
+    bool escaped;
+    int count;          /**< Iterations until |z| reached 2. */
+    dvec2 z[4];         /**< z and its derivatives from two iterations before count to one after. */
+    dvec2 dz[4];        /**< dz/dc */
+    dvec2 ddz[4];       /**< d^2z/dc^2 */
+    double distance;    /**< Lower bound for the distance to the set. */
+};
+
+
+static dvec2 cmul(const dvec2& a, const dvec2& b)
+{
+    return dvec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+
+static DistanceEstimate estimate_distance(const dvec2& c, const KernelArgs& args)
+{
+    DistanceEstimate e;
+    e.escaped = false;
+
+    if (in_main_bulbs(c.x, c.y)) return e;
+
+    PeriodicityCheck<double> cycle;
+    cycle.reset(0.0, 0.0);
+
+    dvec2 z(0,0);
+    dvec2 dz(0,0);
+    dvec2 ddz(0,0);
+
+    e.z[1] = z;
+    e.dz[1] = dz;
+    e.ddz[1] = ddz;
+
+    int it = 0;
+    int next_check = first_periodicity_check(args);
+
+    while (glm::dot(z, z) < 4.0) {
+        if (it == args.max_iterations) return e;
+
+        e.z[0] = e.z[1];
+        e.dz[0] = e.dz[1];
+        e.ddz[0] = e.ddz[1];
+        e.z[1] = z;
+        e.dz[1] = dz;
+        e.ddz[1] = ddz;
+
+        it++;
+        ddz = 2.0 * (cmul(dz, dz) + cmul(z, ddz));
+        dz = 2.0 * cmul(z, dz) + dvec2(1,0);
+        z = cmul(z, z) + c;
+
+        if (it == next_check) {
+            next_check += args.periodicity_check;
+            if (cycle.check(z.x, z.y, args.periodicity_tolerance)) return e;
+        }
+    }
+
+    e.escaped = true;
+    e.count = it;
+    e.z[2] = z;
+    e.dz[2] = dz;
+    e.ddz[2] = ddz;
+
+    // Also needed if z already lies beyond estimate_radius
+    ddz = 2.0 * (cmul(dz, dz) + cmul(z, ddz));
+    dz = 2.0 * cmul(z, dz) + dvec2(1,0);
+    z = cmul(z, z) + c;
+
+    e.z[3] = z;
+    e.dz[3] = dz;
+    e.ddz[3] = ddz;
+
+    while (glm::dot(z, z) < estimate_radius * estimate_radius) {
+        dz = 2.0 * cmul(z, dz) + dvec2(1,0);
+        z = cmul(z, z) + c;
+    }
+
+    const double z_abs = glm::length(z);
+    e.distance = 2.0 * z_abs * std::log(z_abs) / glm::length(dz) / 4.0;
+
+    return e;
+}
+
+
+/**
+ * @param center Complex coordinate of the center of r.
+ * @return false if the distance estimate doesn't cover r.
+ */
+static bool fill(const KernelArgs& args, const Tile& r, const dvec2& center, IterationBuffer& buffer)
+{
+    const DistanceEstimate e = estimate_distance(center, args);
+
+    // Distance between neighbouring pixels of the buffer
+    const double spacing = args.step * args.lattice.step;
+
+    const double half_diagonal = 0.5 * spacing * glm::length(dvec2(r.w - 1, r.h - 1));
+    if (!e.escaped || !(e.distance > half_diagonal)) return false;
+
+    // To first order log z_k changes by dz_k / z_k delta, so |z_k| >= 2 on
+    // one side of a line through the square. The smooth counts of the pixels
+    // also take the second order term (ddz_k / z_k - (dz_k / z_k)^2) delta^2 / 2.
+    dvec2 gradient[4];
+    dvec2 curvature[4];
+    double log_abs[4];
+
+    for (int k = 0; k < 4; ++k) {
+        const double z2 = glm::dot(e.z[k], e.z[k]);
+
+        if (z2 > 0.0) {
+            const dvec2 inverse = dvec2(e.z[k].x, -e.z[k].y) / z2;
+
+            gradient[k] = cmul(e.dz[k], inverse);
+            curvature[k] = cmul(e.ddz[k], inverse) - cmul(gradient[k], gradient[k]);
+            log_abs[k] = 0.5 * std::log(z2);
+        } else {
+            // z_0 = 0, or no iteration at all
+            gradient[k] = curvature[k] = dvec2(0,0);
+            log_abs[k] = -std::numeric_limits<double>::infinity();
+        }
+    }
+
+    // log|z_k| at offset d from the center
+    auto linear = [&](int k, const dvec2& d) {
+        return log_abs[k] + cmul(gradient[k], d).x;
+    };
+
+    auto quadratic = [&](int k, const dvec2& d) {
+        return linear(k, d) + 0.5 * cmul(curvature[k], cmul(d, d)).x;
+    };
+
+    const double log_bailout = std::log(2.0);
+
+    // The first order borders are straight, so the corners tell if all
+    // pixels of the square escape within one iteration of the center.
+    const double corner_x = 0.5 * (r.w - 1) * spacing;
+    const double corner_y = 0.5 * (r.h - 1) * spacing;
+
+    for (int i = 0; i < 4; ++i) {
+        const double dx = i & 1 ? corner_x : -corner_x;
+        const double dy = i & 2 ? corner_y : -corner_y;
+
+        if (linear(0, dvec2(dx, dy)) >= log_bailout || linear(3, dvec2(dx, dy)) < log_bailout) return false;
+    }
+
+    for (int y = r.y; y < r.y + r.h; ++y) {
+        Pixel* out = buffer.row(y);
+        const double dy = args.origin.y + args.lattice.get_pixel(0, y).y * args.step - center.y;
+
+        for (int x = r.x; x < r.x + r.w; ++x) {
+            const dvec2 d(args.origin.x + args.lattice.get_pixel(x, 0).x * args.step - center.x, dy);
+
+            // Orbit point at which the pixel escapes, z_(count-1) for k=1.
+            // z_(count+1) escapes by the corners, also where the curvature
+            // pulls it just below 2.
+            const int k = quadratic(1, d) >= log_bailout ? 1 : quadratic(2, d) >= log_bailout ? 2 : 3;
+            const double r2 = maximum(std::exp(2.0 * quadratic(k, d)), 4.0);
+
+            out[x] = orbit_pixel(e.count - 2 + k, args.max_iterations, r2);
+        }
+    }
+
+    return true;
+}
+
+
+int render_exterior_filled(const KernelArgs& args, TileKernel kernel, const Tile& tile, IterationBuffer& buffer)
+{
+    if (tile.w < 2 * min_fill_size || tile.h < 2 * min_fill_size) {
+        kernel(args, tile, buffer);
+        return tile.w * tile.h;
+    }
+
+    const dvec2 middle = dvec2(args.lattice.phase) + dvec2(tile.x + 0.5 * (tile.w - 1), tile.y + 0.5 * (tile.h - 1)) * (double)args.lattice.step;
+    const dvec2 center = args.origin + middle * args.step;
+
+    if (fill(args, tile, center, buffer)) return 0;
+
+    const int w = tile.w / 2;
+    const int h = tile.h / 2;
+
+    const Tile quarters[4] = {
+        { tile.x,     tile.y,     w,          h          },
+        { tile.x + w, tile.y,     tile.w - w, h          },
+        { tile.x,     tile.y + h, w,          tile.h - h },
+        { tile.x + w, tile.y + h, tile.w - w, tile.h - h },
+    };
+
+    int iterated = 0;
+
+    for (const Tile& quarter : quarters) {
+        iterated += render_exterior_filled(args, kernel, quarter, buffer);
+    }
+
+    return iterated;
+}
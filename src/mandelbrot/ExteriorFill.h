@@ -0,0 +1,24 @@
+#pragma once
+
+#include "common.h"
+
+#include "IterationBuffer.h"
+#include "Kernel.h"
+
+
+/**
+ * Renders a tile of the Mandelbrot set in doubles, filling squares far from
+ * the set from distance estimates instead of iterating their pixels.
+ *
+ * The point at the center of a square is iterated together with the
+ * derivative dz/dc. If it escapes, 2 |z| log|z| / |dz| estimates its
+ * distance to the set, and by the Koebe 1/4 theorem a quarter of that is a
+ * lower bound. Squares inside that disk contain only exterior pixels. Their
+ * smooth iteration counts are extrapolated from the center with the first
+ * two derivatives. Pixels near the edges of the bands may escape one
+ * iteration off, which changes their smooth count by up to a few tenths.
+ * Other squares are split into quarters, small ones are passed to kernel.
+ *
+ * @return Number of pixels iterated by kernel.
+ */
+int render_exterior_filled(const KernelArgs& args, TileKernel kernel, const Tile& tile, IterationBuffer& buffer);
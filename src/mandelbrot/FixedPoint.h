@@ -0,0 +1,122 @@
+#pragma once
+
+#include "common.h"
+
+#include "BigFloat.h"
+#include "Float128.h"
+
+#include <cstdint>
+
+
+/**
+ * Signed 128-bit fixed point numbers with 3 integer and 124 fraction bits,
+ * covering [-8,8) in steps of 2^-124. At pixel spacings around 1e-26 that
+ * leaves about 40 bits for the rounding errors of the iteration.
+ */
+typedef __int128 fixed128;
+typedef unsigned __int128 ufixed128;
+
+static const int fixed_fraction_bits = 124;
+
+
+/**
+ * Exact for doubles in [-8,8). Values outside the range saturate to its ends
+ * instead of overflowing the integer conversion, NaN goes to the upper end.
+ * Points that far out escape in the first iteration anyway.
+ */
+inline fixed128 to_fixed(double v)
+{
+    static const double largest = std::nextafter(8.0, 0.0);
+
+    v = v < -8.0 ? -8.0 : (v < largest ? v : largest);
+
+    return (fixed128)ldexp(v, fixed_fraction_bits);
+}
+
+
+/**
+ * Round an arbitrary precision number to fixed point. Three doubles carry
+ * more than the 124 fraction bits for values below 8. Values outside
+ * [-8,8) saturate like to_fixed(double).
+ */
+inline fixed128 to_fixed(const BigFloat& v)
+{
+    BigFloat rest(v);
+    fixed128 result = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        const double part = rest.to_double();
+
+        if (i == 0 && !(fabs(part) < 8.0)) {
+            return to_fixed(part);
+        }
+
+        result += to_fixed(part);
+        rest -= BigFloat(part, BigFloat::limb_bits);
+    }
+
+    return result;
+}
+
+
+/**
+ * Exact for the 113 most significant bits, enough for tests like the main
+ * cardioid that are cheap compared to iterating in fixed point.
+ */
+inline float128 fixed_to_float128(fixed128 v)
+{
+    return (float128)v / ((float128)((ufixed128)1 << fixed_fraction_bits));
+}
+
+
+inline double fixed_to_double(fixed128 v)
+{
+    return ldexp((double)v, -fixed_fraction_bits);
+}
+
+
+inline ufixed128 fixed_abs(fixed128 v)
+{
+    return v < 0 ? -(ufixed128)v : (ufixed128)v;
+}
+
+
+/**
+ * Product of two magnitudes, truncated. The result has to stay below 16.
+ * Only the upper half of the 256-bit product is needed, built from four
+ * 64x64 bit multiplications.
+ */
+inline ufixed128 fixed_umul(ufixed128 a, ufixed128 b)
+{
+    const uint64_t ah = (uint64_t)(a >> 64), al = (uint64_t)a;
+    const uint64_t bh = (uint64_t)(b >> 64), bl = (uint64_t)b;
+
+    const ufixed128 hh = (ufixed128)ah * bh;
+    const ufixed128 hl = (ufixed128)ah * bl;
+    const ufixed128 lh = (ufixed128)al * bh;
+    const ufixed128 ll = (ufixed128)al * bl;
+
+    // Bits 64..127 and 128..255 of the product
+    const ufixed128 mid = (ufixed128)(uint64_t)hl + (uint64_t)lh + (ll >> 64);
+    const ufixed128 high = hh + (hl >> 64) + (lh >> 64) + (mid >> 64);
+
+    return (high << (128 - fixed_fraction_bits)) | ((uint64_t)mid >> (fixed_fraction_bits - 64));
+}
+
+
+/**
+ * Square of a magnitude below 4, with three instead of four multiplications.
+ */
+inline ufixed128 fixed_usqr(ufixed128 a)
+{
+    const uint64_t ah = (uint64_t)(a >> 64), al = (uint64_t)a;
+
+    const ufixed128 hh = (ufixed128)ah * ah;
+    const ufixed128 hl = (ufixed128)ah * al;
+    const ufixed128 ll = (ufixed128)al * al;
+
+    const ufixed128 mid = ((ufixed128)(uint64_t)hl << 1) + (ll >> 64);
+    const ufixed128 high = hh + ((hl >> 64) << 1) + (mid >> 64);
+
+    return (high << (128 - fixed_fraction_bits)) | ((uint64_t)mid >> (fixed_fraction_bits - 64));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "common.h"
+
+#include "BigFloat.h"
+
+
+/**
+ * IEEE quadruple precision with a 113-bit mantissa. GCC and Clang emulate
+ * it in software on x86-64, which is slow but needs no extra library for
+ * the four basic operations.
+ */
+typedef __float128 float128;
+
+
+/**
+ * Round an arbitrary precision number to quadruple precision. Three doubles
+ * carry more than the 113 mantissa bits.
+ */
+inline float128 to_float128(const BigFloat& v)
+{
+    BigFloat rest(v);
+    float128 result = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        const double part = rest.to_double();
+        result += part;
+        rest -= BigFloat(part, BigFloat::limb_bits);
+    }
+
+    return result;
+}
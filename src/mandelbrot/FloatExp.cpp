@@ -0,0 +1,57 @@
+#include "FloatExp.h"
+
+
+floatexp::floatexp(const BigFloat& v)
+    : m(0.0)
+    , e(0)
+{
+    if (v.is_zero()) return;
+
+    // Scale into [0.5,1) first, to_double() can't return smaller values.
+    BigFloat mantissa(v);
+    mantissa.mul_2exp(-v.get_exponent());
+
+    m = mantissa.to_double();
+    e = v.get_exponent();
+}
+
+
+bool floatexp::parse(const string& s, floatexp& out)
+{
+    BigFloat value;
+
+    if (!BigFloat::parse(s, BigFloat::limb_bits, value)) {
+        return false;
+    }
+
+    out = floatexp(value);
+    return true;
+}
+
+
+BigFloat floatexp::to_bigfloat(int bits) const
+{
+    BigFloat result(m, bits);
+    result.mul_2exp(e);
+
+    return result;
+}
+
+
+string floatexp::to_string() const
+{
+    std::stringstream ss;
+
+    if (fits_double()) {
+        ss << std::setprecision(17) << to_double();
+        return ss.str();
+    }
+
+    // m 2^e = d 10^k with 1 <= |d| < 10
+    const double exponent10 = std::log10(fabs(m)) + e * std::log10(2.0);
+    const double k = floor(exponent10);
+    const double d = pow(10.0, exponent10 - k);
+
+    ss << std::setprecision(12) << (m < 0 ? -d : d) << "e" << (long)k;
+    return ss.str();
+}
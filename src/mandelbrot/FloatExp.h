@@ -0,0 +1,245 @@
+#pragma once
+
+#include "common.h"
+
+#include "BigFloat.h"
+
+#include <cmath>
+
+
+/**
+ * Mantissas may drift this many binary orders of magnitude away from 1
+ * before they are renormalized. Renormalizing needs frexp, so deferring it
+ * keeps most operations at the speed of two or three double instructions.
+ */
+static const int floatexp_drift = 256;
+
+/**
+ * Binary exponents of the values that count as safely inside the double
+ * range, with room for the squares of the perturbation iteration.
+ */
+static const long floatexp_min_double = -960;
+static const long floatexp_max_double = 960;
+
+
+/**
+ * ldexp for exponents beyond the int range, which over- or underflow anyway.
+ */
+inline double floatexp_ldexp(double m, long e)
+{
+    return ldexp(m, (int)maximum(-4000L, minimum(4000L, e)));
+}
+
+
+inline bool floatexp_drifted(double m)
+{
+    const double f = fabs(m);
+    return f != 0.0 && (f > ldexp(1.0, floatexp_drift) || f < ldexp(1.0, -floatexp_drift));
+}
+
+
+/**
+ * Extended range number m * 2^e for quantities below 1e-308 like the pixel
+ * spacing and perturbation deltas of very deep zooms.
+ */
+struct floatexp
+{
+    double m;   /**< Mantissa, zero or within 2^floatexp_drift of 1. */
+    long e;     /**< Binary exponent. */
+
+    floatexp() : m(0.0), e(0) {}
+    floatexp(double v) : m(v), e(0) { adjust(); }
+    floatexp(double m, long e) : m(m), e(e) { adjust(); }
+
+    explicit floatexp(const BigFloat& v);
+
+    /**
+     * Parse decimal notation with exponents beyond the double range, e.g.
+     * "1.5e-1000".
+     * @return false if s is not a valid number.
+     */
+    static bool parse(const string& s, floatexp& out);
+
+    /**
+     * Renormalize the mantissa if it drifted too far.
+     */
+    floatexp& adjust()
+    {
+        if (floatexp_drifted(m)) {
+            int k;
+            m = frexp(m, &k);
+            e += k;
+        }
+        return *this;
+    }
+
+    double to_double() const { return floatexp_ldexp(m, e); }
+
+    /**
+     * True if the value is zero or a double far from under- and overflow.
+     */
+    bool fits_double() const
+    {
+        return m == 0.0 || (ilogb(m) + e > floatexp_min_double && ilogb(m) + e < floatexp_max_double);
+    }
+
+    double log2() const { return std::log2(fabs(m)) + e; }
+
+    BigFloat to_bigfloat(int bits) const;
+
+    /**
+     * Print in scientific notation with 12 significant digits.
+     */
+    string to_string() const;
+
+    floatexp operator- () const { return floatexp(-m, e); }
+
+    floatexp& operator*= (const floatexp& other)
+    {
+        m *= other.m;
+        e += other.e;
+        return adjust();
+    }
+};
+
+
+inline floatexp operator* (const floatexp& a, const floatexp& b)
+{
+    return floatexp(a.m * b.m, a.e + b.e);
+}
+
+
+inline floatexp operator/ (const floatexp& a, const floatexp& b)
+{
+    return floatexp(a.m / b.m, a.e - b.e);
+}
+
+
+inline floatexp operator+ (const floatexp& a, const floatexp& b)
+{
+    if (a.m == 0.0) return b;
+    if (b.m == 0.0) return a;
+
+    if (a.e >= b.e) {
+        return floatexp(a.m + floatexp_ldexp(b.m, b.e - a.e), a.e);
+    } else {
+        return floatexp(floatexp_ldexp(a.m, a.e - b.e) + b.m, b.e);
+    }
+}
+
+
+inline floatexp operator- (const floatexp& a, const floatexp& b)
+{
+    return a + (-b);
+}
+
+
+inline floatexp abs(const floatexp& a)
+{
+    return floatexp(fabs(a.m), a.e);
+}
+
+
+// Comparisons look at the sign of the difference.
+inline bool operator<  (const floatexp& a, const floatexp& b) { return (a - b).m <  0.0; }
+inline bool operator<= (const floatexp& a, const floatexp& b) { return (a - b).m <= 0.0; }
+inline bool operator>  (const floatexp& a, const floatexp& b) { return (a - b).m >  0.0; }
+inline bool operator>= (const floatexp& a, const floatexp& b) { return (a - b).m >= 0.0; }
+inline bool operator== (const floatexp& a, const floatexp& b) { return (a - b).m == 0.0; }
+inline bool operator!= (const floatexp& a, const floatexp& b) { return (a - b).m != 0.0; }
+
+
+/**
+ * Complex or 2D floatexp with one exponent shared by both components.
+ */
+struct floatexp2
+{
+    dvec2 m;
+    long e;
+
+    floatexp2() : m(0,0), e(0) {}
+    floatexp2(const dvec2& v) : m(v), e(0) { adjust(); }
+    floatexp2(const dvec2& m, long e) : m(m), e(e) { adjust(); }
+
+    floatexp2(const floatexp& x, const floatexp& y)
+        : m(x.m, y.m)
+        , e(maximum(x.e, y.e))
+    {
+        m.x = floatexp_ldexp(m.x, x.e - e);
+        m.y = floatexp_ldexp(m.y, y.e - e);
+        adjust();
+    }
+
+    floatexp2& adjust()
+    {
+        const double f = maximum(fabs(m.x), fabs(m.y));
+
+        if (floatexp_drifted(f)) {
+            int k;
+            frexp(f, &k);
+            m = dvec2(ldexp(m.x, -k), ldexp(m.y, -k));
+            e += k;
+        }
+        return *this;
+    }
+
+    floatexp x() const { return floatexp(m.x, e); }
+    floatexp y() const { return floatexp(m.y, e); }
+
+    dvec2 to_dvec2() const { return dvec2(floatexp_ldexp(m.x, e), floatexp_ldexp(m.y, e)); }
+
+    bool fits_double() const
+    {
+        return floatexp(maximum(fabs(m.x), fabs(m.y)), e).fits_double();
+    }
+
+    floatexp length() const { return floatexp(glm::length(m), e); }
+
+    floatexp2 operator- () const { return floatexp2(-m, e); }
+};
+
+
+inline floatexp2 operator+ (const floatexp2& a, const floatexp2& b)
+{
+    if (a.m == dvec2(0,0)) return b;
+    if (b.m == dvec2(0,0)) return a;
+
+    if (a.e >= b.e) {
+        return floatexp2(a.m + dvec2(floatexp_ldexp(b.m.x, b.e - a.e), floatexp_ldexp(b.m.y, b.e - a.e)), a.e);
+    } else {
+        return floatexp2(dvec2(floatexp_ldexp(a.m.x, a.e - b.e), floatexp_ldexp(a.m.y, a.e - b.e)) + b.m, b.e);
+    }
+}
+
+
+inline floatexp2 operator- (const floatexp2& a, const floatexp2& b)
+{
+    return a + (-b);
+}
+
+
+/**
+ * Complex product.
+ */
+inline floatexp2 operator* (const floatexp2& a, const floatexp2& b)
+{
+    return floatexp2(dvec2(a.m.x*b.m.x - a.m.y*b.m.y, a.m.x*b.m.y + a.m.y*b.m.x), a.e + b.e);
+}
+
+
+/**
+ * Complex product with a double precision factor like the reference orbit.
+ */
+inline floatexp2 operator* (const dvec2& a, const floatexp2& b)
+{
+    return floatexp2(dvec2(a.x*b.m.x - a.y*b.m.y, a.x*b.m.y + a.y*b.m.x), b.e);
+}
+
+
+/**
+ * Scaling by a real number.
+ */
+inline floatexp2 operator* (const floatexp2& a, const floatexp& f)
+{
+    return floatexp2(a.m * f.m, a.e + f.e);
+}
@@ -0,0 +1,97 @@
+#include "GPUOrbitBuffer.h"
+
+#include "Statistics.h"
+
+
+GPUOrbitBuffer::GPUOrbitBuffer()
+    : size(0,0)
+    , z(0)
+    , iterations(0)
+    , scratch(0)
+{
+}
+
+
+GPUOrbitBuffer::~GPUOrbitBuffer()
+{
+    statistics.free_orbit_memory(get_memory());
+}
+
+
+void GPUOrbitBuffer::resize(const ivec2& new_size)
+{
+    if (new_size == size) return;
+
+    statistics.free_orbit_memory(get_memory());
+
+    size = new_size;
+    z.resize(size.x * size.y * sizeof(uvec4));
+    iterations.resize(size.x * size.y * sizeof(int));
+
+    statistics.alloc_orbit_memory(get_memory());
+}
+
+
+void GPUOrbitBuffer::shift(const ivec2& offset)
+{
+    // The exposed pixels are rendered again anyway
+    if (abs(offset.x) >= size.x || abs(offset.y) >= size.y) return;
+
+    if (scratch.get_size() < z.get_size()) {
+        statistics.free_orbit_memory(get_memory());
+        scratch.resize(z.get_size());
+        statistics.alloc_orbit_memory(get_memory());
+    }
+
+    shift_rows(z, sizeof(uvec4), offset);
+    shift_rows(iterations, sizeof(int), offset);
+}
+
+
+void GPUOrbitBuffer::shift_rows(const GL::Buffer& buffer, size_t element, const ivec2& offset)
+{
+    const int w = size.x - abs(offset.x);
+    const int h = size.y - abs(offset.y);
+
+    const int src_x = maximum(offset.x, 0);
+    const int dst_x = maximum(-offset.x, 0);
+    const int src_y = maximum(offset.y, 0);
+    const int dst_y = maximum(-offset.y, 0);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer.get_id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, scratch.get_id());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size.x * size.y * element);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, scratch.get_id());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.get_id());
+
+    for (int y = 0; y < h; ++y) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            ((src_y + y) * size.x + src_x) * element,
+                            ((dst_y + y) * size.x + dst_x) * element,
+                            w * element);
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+
+void GPUOrbitBuffer::bind(GL::Shader& shader) const
+{
+    z.bind(GL_SHADER_STORAGE_BUFFER, 3);
+    iterations.bind(GL_SHADER_STORAGE_BUFFER, 4);
+
+    shader.set_buffer("orbit_points", z);
+    shader.set_buffer("orbit_counts", iterations);
+}
+
+
+void GPUOrbitBuffer::unbind() const
+{
+    iterations.unbind();
+    z.unbind();
+
+    // Make the stores visible to the next draw and to shift()
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "common.h"
+
+#include "GL/Buffer.h"
+#include "GL/Shader.h"
+
+
+/**
+ * Iteration count of the orbits that escaped below the limit, see
+ * GPUOrbitBuffer. orbit_settled of OrbitBuffer.h marks the ones that never
+ * escape.
+ */
+static const int orbit_escaped = -2;
+
+
+/**
+ * Counterpart of OrbitBuffer for the GL engine, in two shader storage
+ * buffers the float, df64 and double iteration shaders write while they
+ * render and read back when they continue. Each pixel keeps the raw bits of
+ * its last z in the arithmetic of the shader that saved it, and the
+ * iteration it belongs to. 0 iterations start over, which is what
+ * subdivide.compute leaves in the blocks it fills, pixels in the main bulbs
+ * or caught in a cycle are settled and escaped ones are never continued.
+ * Rows are stored bottom to top like in the iteration texture. Takes 20
+ * bytes per pixel, and a scratch copy of the z buffer once the view is
+ * panned.
+ */
+class GPUOrbitBuffer : public noncopyable
+{
+    ivec2 size;
+    GL::Buffer z;           /**< uvec4 per pixel */
+    GL::Buffer iterations;  /**< int per pixel */
+    GL::Buffer scratch;     /**< Source of shift(), copies between overlapping ranges are undefined. */
+
+    public:
+
+    GPUOrbitBuffer();
+    ~GPUOrbitBuffer();
+
+    /**
+     * Resize to the view, the contents are undefined until it is rendered.
+     */
+    void resize(const ivec2& new_size);
+
+    const ivec2& get_size() const { return size; }
+
+    /**
+     * Move the contents like Colorizer::shift_iterations(), the uncovered
+     * pixels are undefined until they are rendered.
+     */
+    void shift(const ivec2& offset);
+
+    /**
+     * Bind the buffers to the storage blocks orbit_points and orbit_counts
+     * of shader, which has to be bound.
+     */
+    void bind(GL::Shader& shader) const;
+    void unbind() const;
+
+    size_t get_memory() const { return z.get_size() + iterations.get_size() + scratch.get_size(); }
+
+    private:
+
+    /**
+     * Row moves of shift() for one of the buffers with element bytes per pixel.
+     */
+    void shift_rows(const GL::Buffer& buffer, size_t element, const ivec2& offset);
+};
@@ -0,0 +1,82 @@
+#include "IterationBuffer.h"
+
+#include "Kernel.h"
+
+
+IterationBuffer::IterationBuffer()
+    : size(0,0)
+{
+}
+
+
+void IterationBuffer::resize(const ivec2& new_size)
+{
+    size = new_size;
+    data.resize(size.x * size.y);
+}
+
+
+void IterationBuffer::clear()
+{
+    std::fill(data.begin(), data.end(), not_iterated);
+}
+
+
+void IterationBuffer::shift(const ivec2& offset)
+{
+    const int w = size.x - abs(offset.x);
+    const int h = size.y - abs(offset.y);
+
+    if (w <= 0 || h <= 0) {
+        clear();
+        return;
+    }
+
+    const int src_x = maximum(offset.x, 0);
+    const int dst_x = maximum(-offset.x, 0);
+
+    // Copy in the direction the rows move, so none is overwritten before it was read
+    if (offset.y >= 0) {
+        for (int y = 0; y < h; ++y) {
+            memmove(row(y) + dst_x, row(y + offset.y) + src_x, w * sizeof(Pixel));
+        }
+    } else {
+        for (int y = h - 1; y >= 0; --y) {
+            memmove(row(y - offset.y) + dst_x, row(y) + src_x, w * sizeof(Pixel));
+        }
+    }
+
+    for (const Tile& tile : get_exposed_tiles(size, offset)) {
+        for (int y = tile.y; y < tile.y + tile.h; ++y) {
+            std::fill_n(row(y) + tile.x, tile.w, not_iterated);
+        }
+    }
+}
+
+
+static unsigned char palette(double p, double period)
+{
+    // Matches the sine lookup texture sampled with p/period in colorize.frag.
+    double v = sin(p / period * M_PI * 2.0) * 0.5 + 0.5;
+    return (unsigned char)(v * 255.0 + 0.5);
+}
+
+
+void IterationBuffer::colorize(double palette_offset, vector<unsigned char>& rgb) const
+{
+    rgb.resize(data.size() * 3);
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        // Glitched pixels keep the count they had when detected
+        if (data[i].has(PIXEL_INTERIOR) || data[i].has(PIXEL_NOT_ITERATED)) {
+            rgb[i*3+0] = rgb[i*3+1] = rgb[i*3+2] = 0;
+            continue;
+        }
+
+        const double p = data[i].count + palette_offset;
+
+        rgb[i*3+0] = palette(p, 23);
+        rgb[i*3+1] = palette(p, 29);
+        rgb[i*3+2] = palette(p, 31);
+    }
+}
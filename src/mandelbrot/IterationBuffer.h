@@ -0,0 +1,99 @@
+#pragma once
+
+#include "common.h"
+
+
+/**
+ * Flags of a pixel, stored next to its count. At most one is set, none
+ * outside the set.
+ */
+enum PixelFlags
+{
+    PIXEL_INTERIOR     = 1,     /**< Reached the iteration limit, or never escapes. */
+    PIXEL_GLITCHED     = 2,     /**< Perturbation result that another reference has to replace. */
+    PIXEL_NOT_ITERATED = 4,
+};
+
+
+/**
+ * Result of one pixel, laid out like a texel of an RG32F texture.
+ */
+struct Pixel
+{
+    float count;    /**< Smooth iteration count outside the set, the iteration limit inside. */
+    float flags;    /**< PixelFlags, a float to share the texel with count. */
+
+    bool has(PixelFlags flag) const { return ((int)flags & flag) != 0; }
+
+    bool operator==(const Pixel& other) const { return count == other.count && flags == other.flags; }
+    bool operator!=(const Pixel& other) const { return !(*this == other); }
+};
+
+
+static const Pixel not_iterated = { 0.0f, (float)PIXEL_NOT_ITERATED };
+
+
+inline Pixel interior_pixel(int max_iterations)
+{
+    return { (float)max_iterations, (float)PIXEL_INTERIOR };
+}
+
+
+/**
+ * Pixel whose orbit ended at iteration count with |z|^2 = r2, inside the set
+ * if count reached the limit. Escaped orbits get the smooth count
+ * n + 1 - log2(log2|z_n|), which runs continuously across the bands of equal
+ * n, so the palette shows no steps.
+ */
+inline Pixel orbit_pixel(int count, int max_iterations, double r2)
+{
+    if (count >= max_iterations) return interior_pixel(max_iterations);
+
+    return { (float)(count + 1 - std::log2(0.5 * std::log2(r2))), 0.0f };
+}
+
+
+/**
+ * Per-pixel escape-time results of the CPU engine.
+ * Rows are stored bottom to top so the data can be uploaded to a texture as is.
+ */
+class IterationBuffer
+{
+    ivec2 size;
+    vector<Pixel> data;
+
+    public:
+
+    IterationBuffer();
+
+    void resize(const ivec2& new_size);
+
+    const ivec2& get_size() const { return size; }
+
+    /**
+     * Mark all pixels as not iterated.
+     */
+    void clear();
+
+    /**
+     * Move the contents so that pixel (x,y) gets the value of pixel
+     * (x,y) + offset, see View::get_shift(). Uncovered pixels are not
+     * iterated.
+     */
+    void shift(const ivec2& offset);
+
+    Pixel* row(int y) { return &data[y * size.x]; }
+    const Pixel* row(int y) const { return &data[y * size.x]; }
+
+    /**
+     * Counts and flags interleaved, for an RG texture.
+     */
+    const float* get_data() const { return &data[0].count; }
+
+    /**
+     * Convert to 8-bit RGB with the same palette as the fragment shaders.
+     * @param palette_offset Shift of the palette in iterations.
+     * @param rgb Output pixel data, three bytes per pixel.
+     */
+    void colorize(double palette_offset, vector<unsigned char>& rgb) const;
+};
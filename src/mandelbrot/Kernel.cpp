@@ -0,0 +1,309 @@
+#include "Kernel.h"
+
+#include "OrbitBuffer.h"
+#include "Statistics.h"
+
+
+vector<Tile> get_exposed_tiles(const ivec2& size, const ivec2& shift)
+{
+    if (abs(shift.x) >= size.x || abs(shift.y) >= size.y) {
+        return { { 0, 0, size.x, size.y } };
+    }
+
+    vector<Tile> tiles;
+
+    // Columns over the full height, rows between them
+    if (shift.x > 0) tiles.push_back({ size.x - shift.x, 0, shift.x, size.y });
+    if (shift.x < 0) tiles.push_back({ 0, 0, -shift.x, size.y });
+
+    const int x = maximum(-shift.x, 0);
+    const int w = size.x - abs(shift.x);
+
+    if (shift.y > 0) tiles.push_back({ x, size.y - shift.y, w, shift.y });
+    if (shift.y < 0) tiles.push_back({ x, 0, w, -shift.y });
+
+    return tiles;
+}
+
+
+/**
+ * Iterate z from iteration it on, z is left at the last orbit point.
+ * @param periodic Incremented if the orbit was found in a cycle.
+ */
+template <typename Real>
+static inline int escape_time(Real& zx, Real& zy, Real cx, Real cy, int it, const KernelArgs& args, int& periodic)
+{
+    const Real tolerance = (Real)args.periodicity_tolerance;
+
+    PeriodicityCheck<Real> cycle;
+    cycle.reset(zx, zy);
+
+    int next_check = it + first_periodicity_check(args);
+
+    Real zx2 = zx * zx;
+    Real zy2 = zy * zy;
+
+    while (it < args.max_iterations && zx2 + zy2 < 4) {
+        it++;
+        zy = 2 * zx * zy + cy;
+        zx = zx2 - zy2 + cx;
+        zx2 = zx * zx;
+        zy2 = zy * zy;
+
+        if (it == next_check) {
+            next_check += args.periodicity_check;
+
+            if (cycle.check(zx, zy, tolerance)) {
+                ++periodic;
+                return args.max_iterations;
+            }
+        }
+    }
+
+    return it;
+}
+
+
+/**
+ * Iterate one pixel in doubles from z at iteration it and save its orbit
+ * point if it reaches the limit.
+ */
+static void iterate_pixel(const KernelArgs& args, int x, int y, dvec2 z, const dvec2& c, int it, Pixel* out, int& periodic)
+{
+    const int cycles = periodic;
+    const int count = escape_time(z.x, z.y, c.x, c.y, it, args, periodic);
+
+    out[x] = orbit_pixel(count, args.max_iterations, glm::dot(z, z));
+
+    if (!args.orbits || count < args.max_iterations) return;
+
+    if (periodic != cycles) {
+        args.orbits->settle(x, y);
+    } else {
+        args.orbits->save(x, y, z, count);
+    }
+}
+
+
+void scalar_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    int periodic = 0;
+
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+        Pixel* out = buffer.row(y);
+
+        for (int x = tile.x; x < tile.x + tile.w; ++x) {
+            // Escaped below the old limit, or not iterated at all
+            if (args.continue_from > 0 && !out[x].has(PIXEL_INTERIOR)) continue;
+
+            const int it = args.continue_from > 0 ? args.orbits->get_iterations(x, y) : 0;
+            const dvec2 p = args.origin + dvec2(args.lattice.get_pixel(x, y)) * args.step;
+
+            if (it == orbit_settled) {
+                out[x] = interior_pixel(args.max_iterations);
+            } else if (it > 0) {
+                iterate_pixel(args, x, y, args.orbits->get_z(x, y), args.julia ? args.c : p, it, out, periodic);
+            } else if (args.julia) {
+                iterate_pixel(args, x, y, p, args.c, 0, out, periodic);
+            } else if (in_main_bulbs(p.x, p.y)) {
+                out[x] = interior_pixel(args.max_iterations);
+                if (args.orbits) args.orbits->settle(x, y);
+            } else {
+                iterate_pixel(args, x, y, dvec2(0,0), p, 0, out, periodic);
+            }
+        }
+    }
+
+    statistics.count_periodic(periodic);
+}
+
+
+template <typename Real>
+static void wide_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    const Real origin_re = (Real)args.wide_origin_re;
+    const Real origin_im = (Real)args.wide_origin_im;
+    const Real step = (Real)args.wide_step;
+
+    int periodic = 0;
+
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+        Pixel* out = buffer.row(y);
+
+        const Real p_im = origin_im + step * args.lattice.get_pixel(0, y).y;
+
+        for (int x = tile.x; x < tile.x + tile.w; ++x) {
+            const Real p_re = origin_re + step * args.lattice.get_pixel(x, 0).x;
+
+            Real zx = args.julia ? p_re : 0;
+            Real zy = args.julia ? p_im : 0;
+
+            if (!args.julia && in_main_bulbs(p_re, p_im)) {
+                out[x] = interior_pixel(args.max_iterations);
+                continue;
+            }
+
+            const int count = args.julia ? escape_time<Real>(zx, zy, args.c.x, args.c.y, 0, args, periodic)
+                                         : escape_time<Real>(zx, zy, p_re, p_im, 0, args, periodic);
+
+            out[x] = orbit_pixel(count, args.max_iterations, (double)(zx * zx + zy * zy));
+        }
+    }
+
+    statistics.count_periodic(periodic);
+}
+
+
+void long_double_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    wide_kernel<long double>(args, tile, buffer);
+}
+
+
+void float128_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    wide_kernel<float128>(args, tile, buffer);
+}
+
+
+void fixed128_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    const ufixed128 two = (ufixed128)2 << fixed_fraction_bits;
+    const ufixed128 four = (ufixed128)4 << fixed_fraction_bits;
+
+    const fixed128 julia_re = to_fixed(args.c.x);
+    const fixed128 julia_im = to_fixed(args.c.y);
+    const fixed128 tolerance = to_fixed(args.periodicity_tolerance);
+
+    int periodic = 0;
+
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+        Pixel* out = buffer.row(y);
+
+        const fixed128 p_im = args.fixed_origin_im + args.fixed_step * args.lattice.get_pixel(0, y).y;
+
+        for (int x = tile.x; x < tile.x + tile.w; ++x) {
+            const fixed128 p_re = args.fixed_origin_re + args.fixed_step * args.lattice.get_pixel(x, 0).x;
+
+            if (!args.julia && in_main_bulbs(fixed_to_float128(p_re), fixed_to_float128(p_im))) {
+                out[x] = interior_pixel(args.max_iterations);
+                continue;
+            }
+
+            const fixed128 c_re = args.julia ? julia_re : p_re;
+            const fixed128 c_im = args.julia ? julia_im : p_im;
+
+            fixed128 zx = args.julia ? p_re : 0;
+            fixed128 zy = args.julia ? p_im : 0;
+
+            PeriodicityCheck<fixed128> cycle;
+            cycle.reset(zx, zy);
+
+            int it = 0;
+            int next_check = first_periodicity_check(args);
+
+            while (it < args.max_iterations) {
+                // Squares of components of 2 or more would overflow, but
+                // then the orbit escaped anyway.
+                const ufixed128 ax = fixed_abs(zx);
+                const ufixed128 ay = fixed_abs(zy);
+                if (ax >= two || ay >= two) break;
+
+                const ufixed128 zx2 = fixed_usqr(ax);
+                const ufixed128 zy2 = fixed_usqr(ay);
+                if (zx2 + zy2 >= four) break;
+
+                it++;
+
+                const fixed128 xy2 = (fixed128)(fixed_umul(ax, ay) << 1);
+                zy = ((zx < 0) != (zy < 0) ? -xy2 : xy2) + c_im;
+                zx = (fixed128)zx2 - (fixed128)zy2 + c_re;
+
+                if (it == next_check) {
+                    next_check += args.periodicity_check;
+
+                    if (cycle.check(zx, zy, tolerance)) {
+                        ++periodic;
+                        it = args.max_iterations;
+                    }
+                }
+            }
+
+            const dvec2 z(fixed_to_double(zx), fixed_to_double(zy));
+
+            out[x] = orbit_pixel(it, args.max_iterations, glm::dot(z, z));
+        }
+    }
+
+    statistics.count_periodic(periodic);
+}
+
+
+static bool scalar_supported()
+{
+    return true;
+}
+
+
+static bool sse4_supported()
+{
+    return __builtin_cpu_supports("sse4.1");
+}
+
+
+static bool avx2_supported()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+
+static bool avx512_supported()
+{
+    return __builtin_cpu_supports("avx512f") && avx2_supported();
+}
+
+
+// Sorted from fastest to slowest.
+static const KernelVariant variants[] = {
+    { "avx512", avx512_supported, avx512_kernel, avx512_refill_kernel },
+    { "avx2",   avx2_supported,   avx2_kernel,   avx2_refill_kernel   },
+    { "sse4",   sse4_supported,   sse4_kernel,   sse4_refill_kernel   },
+    { "scalar", scalar_supported, scalar_kernel, scalar_kernel        },
+};
+
+
+const KernelVariant& select_kernel_variant(const string& requested)
+{
+    __builtin_cpu_init();
+
+    const size_t count = sizeof(variants) / sizeof(variants[0]);
+    
+    if (requested != "auto") {
+        bool known = false;
+
+        for (size_t i = 0; i < count; ++i) {
+            if (requested != variants[i].name) continue;
+
+            if (variants[i].supported()) {
+                return variants[i];
+            }
+
+            known = true;
+        }
+
+        if (known) {
+            cout << "CPU kernel \"" << requested << "\" is not supported on this machine." << endl;
+        } else {
+            cout << "Unknown CPU kernel \"" << requested << "\"." << endl;
+        }
+        cout << "Falling back to automatic CPU kernel selection." << endl;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (variants[i].supported()) {
+            return variants[i];
+        }
+    }
+
+    return variants[count-1];
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "common.h"
+
+#include "FixedPoint.h"
+#include "Float128.h"
+#include "IterationBuffer.h"
+
+
+class OrbitBuffer;
+
+
+/**
+ * Rectangular part of the image processed by one kernel invocation.
+ */
+struct Tile
+{
+    int x, y;
+    int w, h;
+};
+
+
+/**
+ * Parts of an image that a shift by whole pixels, as found by
+ * View::get_shift(), uncovers. The whole image if nothing remains.
+ */
+vector<Tile> get_exposed_tiles(const ivec2& size, const ivec2& shift);
+
+
+/**
+ * The pixels phase + (x,y) * step of an image, which the coarse passes of
+ * progressive rendering store as pixels (x,y) of a smaller buffer. Kernels
+ * compute the coordinates of a buffer pixel from its image pixel, so they
+ * come out exactly as in a render of the whole image.
+ */
+struct Lattice
+{
+    int step;
+    ivec2 phase;
+
+    Lattice() : step(1), phase(0,0) {}
+    Lattice(int step, const ivec2& phase) : step(step), phase(phase) {}
+
+    /**
+     * Image pixel stored at buffer pixel (x,y).
+     */
+    ivec2 get_pixel(int x, int y) const { return phase + ivec2(x, y) * step; }
+
+    /**
+     * Buffer size for the lattice of an image.
+     */
+    ivec2 get_size(const ivec2& image) const { return (image - phase + step - 1) / step; }
+};
+
+
+/**
+ * Parameters shared by all escape-time kernels.
+ * Image pixel (x,y) maps to origin + (x,y) * step in the complex plane.
+ */
+struct KernelArgs
+{
+    dvec2 origin;       /**< Complex coordinate of image pixel (0,0). */
+    double step;        /**< Distance between neighbouring image pixels. */
+    int max_iterations;
+
+    Lattice lattice;    /**< Image pixels the buffer holds, all by default. */
+
+    bool julia;         /**< Iterate z0=pixel with fixed c instead of z0=0, c=pixel. */
+    dvec2 c;            /**< Julia constant. Unused for the Mandelbrot set. */
+
+    fixed128 fixed_origin_re; /**< origin with the full precision of the fixed point kernel. */
+    fixed128 fixed_origin_im;
+    fixed128 fixed_step;
+
+    float128 wide_origin_re;  /**< origin for the long double and float128 kernels. */
+    float128 wide_origin_im;
+    float128 wide_step;
+
+    int periodicity_check;          /**< Iterations between cycle checks, 0 disables them. */
+    double periodicity_tolerance;   /**< Distance at which orbit samples count as equal. */
+
+    /**
+     * Receives the last orbit point of pixels that reach max_iterations,
+     * NULL if not needed. Only the double precision kernels save it.
+     */
+    OrbitBuffer* orbits;
+
+    /**
+     * 0 iterates every pixel of a tile. Otherwise only pixels marked interior
+     * at this earlier limit are iterated on to max_iterations, from
+     * their point in orbits if they have one. Only supported by the scalar
+     * and the lane refill kernels.
+     */
+    int continue_from;
+};
+
+
+/**
+ * Closed-form membership tests for the main cardioid and the period-2 disc,
+ * where orbits never escape. Their pixels would otherwise all run into
+ * max_iterations. Points outside but within rounding distance of these
+ * boundaries escape only after millions of iterations, so rounding doesn't
+ * change the result at practical iteration limits.
+ */
+template <typename Real>
+inline bool in_main_bulbs(Real x, Real y)
+{
+    const Real y2 = y * y;
+    const Real xq = x - Real(0.25);
+    const Real q = xq * xq + y2;
+
+    if (q * (q + xq) <= Real(0.25) * y2) return true;
+
+    const Real x1 = x + Real(1);
+    return x1 * x1 + y2 <= Real(0.0625);
+}
+
+
+template <typename Real>
+inline bool is_near(Real dx, Real dy, Real tolerance)
+{
+    return dx * dx + dy * dy <= tolerance * tolerance;
+}
+
+
+/**
+ * Fixed point squares of larger distances would overflow, compare the
+ * components instead.
+ */
+inline bool is_near(fixed128 dx, fixed128 dy, fixed128 tolerance)
+{
+    return fixed_abs(dx) <= (ufixed128)tolerance && fixed_abs(dy) <= (ufixed128)tolerance;
+}
+
+
+/**
+ * Brent's cycle detection on an orbit sampled every periodicity_check
+ * iterations. The saved sample is replaced after 1, 2, 4, ... comparisons,
+ * so the gap to it eventually spans a multiple of any cycle length, also of
+ * the sampled orbit. Orbits that return to the saved sample are caught in an
+ * attracting cycle and never escape.
+ */
+template <typename Real>
+struct PeriodicityCheck
+{
+    Real x, y;
+    int compares;
+    int window;
+
+    void reset(Real zx, Real zy)
+    {
+        x = zx;
+        y = zy;
+        compares = 0;
+        window = 1;
+    }
+
+    /**
+     * @return true if (zx, zy) is within tolerance of the saved sample.
+     */
+    bool check(Real zx, Real zy, Real tolerance)
+    {
+        if (is_near(zx - x, zy - y, tolerance)) return true;
+
+        if (++compares == window) {
+            x = zx;
+            y = zy;
+            compares = 0;
+            window *= 2;
+        }
+        return false;
+    }
+};
+
+
+/**
+ * Orbit samples closer than this many pixel spacings count as equal. Exterior
+ * orbits only creep that slowly within a ten-thousandth of a pixel of the
+ * boundary, where they need thousands of iterations or more to escape.
+ */
+static const double periodicity_tolerance_pixels = 1e-4;
+
+
+/**
+ * First iteration that checks for cycles, never reached if they are off.
+ */
+inline int first_periodicity_check(const KernelArgs& args)
+{
+    return args.periodicity_check > 0 ? args.periodicity_check : args.max_iterations + 1;
+}
+
+
+typedef void (*TileKernel)(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+
+
+/**
+ * Set of kernels compiled for one instruction set.
+ * Each vector variant lives in its own translation unit under kernels/ whose
+ * kernel code is built for the matching instruction set, see SIMDKernel.h,
+ * so only the variant chosen at runtime ever executes instructions the CPU
+ * might not support.
+ */
+struct KernelVariant
+{
+    const char* name;
+    bool (*supported)();
+
+    TileKernel escape_time;
+    TileKernel escape_time_refill; /**< Refills finished lanes from a per-tile pixel queue, can continue pixels. */
+};
+
+
+/**
+ * Pick the kernel variant for the running CPU.
+ * @param requested Variant name or "auto" for the fastest supported one.
+ *                  Unsupported requests fall back to "auto" with a warning.
+ */
+const KernelVariant& select_kernel_variant(const string& requested);
+
+
+void scalar_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+
+/**
+ * Scalar kernel in 128-bit fixed point for zooms past the resolution of
+ * doubles. Reads the fixed_* members of args instead of origin and step.
+ */
+void fixed128_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+
+/**
+ * Scalar kernels in x87 long double with a 64-bit mantissa and in software
+ * float128 with 113 bits, for the depths between doubles and fixed point.
+ * Read the wide_* members of args instead of origin and step.
+ */
+void long_double_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+void float128_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+
+void sse4_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+void avx2_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+void avx512_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+
+void sse4_refill_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+void avx2_refill_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
+void avx512_refill_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer);
@@ -1,53 +1,642 @@
 #include "Mandelbrot.h"
 
+#include "Statistics.h"
+
+
+/**
+ * Split into float hi and lo parts with hi + lo = v to about 48 bits.
+ */
+static vec2 split_double(double v)
+{
+    const float hi = (float)v;
+    return vec2(hi, (float)(v - hi));
+}
+
+
+/**
+ * Edge length of the tiles slow views are spread over frames in, each is
+ * one draw call.
+ */
+static const int tile_size = 128;
+
+
+/**
+ * Edge length of the blocks subdivide.compute fills, its work group size.
+ */
+static const int subdivision_block = 32;
+
+
+/**
+ * Pick the glitched pixel of the regions farthest from any other pixel, in
+ * the middle of the largest glitched area. Distances are measured in city
+ * block metric within each region.
+ *
+ * @return false if no pixel is glitched.
+ */
+static bool find_glitch_center(const IterationBuffer& pixels, const vector<Tile>& regions, ivec2& center)
+{
+    int best = 0;
+    vector<int> distance;
+
+    for (const Tile& region : regions) {
+        distance.assign(region.w * region.h, 0);
+
+        auto at = [&](int x, int y) -> int& { return distance[(y - region.y) * region.w + x - region.x]; };
+
+        for (int y = region.y; y < region.y + region.h; ++y) {
+            for (int x = region.x; x < region.x + region.w; ++x) {
+                if (!pixels.row(y)[x].has(PIXEL_GLITCHED)) continue;
+
+                const int left = x > region.x ? at(x - 1, y) : 0;
+                const int below = y > region.y ? at(x, y - 1) : 0;
+                at(x, y) = minimum(left, below) + 1;
+            }
+        }
+
+        for (int y = region.y + region.h - 1; y >= region.y; --y) {
+            for (int x = region.x + region.w - 1; x >= region.x; --x) {
+                if (at(x, y) == 0) continue;
+
+                const int right = x + 1 < region.x + region.w ? at(x + 1, y) : 0;
+                const int above = y + 1 < region.y + region.h ? at(x, y + 1) : 0;
+                at(x, y) = minimum(at(x, y), minimum(right, above) + 1);
+
+                if (at(x, y) > best) {
+                    best = at(x, y);
+                    center = ivec2(x, y);
+                }
+            }
+        }
+    }
+
+    return best > 0;
+}
+
+
 Mandelbrot::Mandelbrot()
     : shader("mandelbrot")
+    , float_shader("mandelbrot_float")
+    , df64_shader("mandelbrot_df64")
+    , perturbation_shader("perturbation")
+    , fill_shader("fill_blocks")
+    , subdivide_shader("subdivide")
+    , glitch_shader("mask_glitches")
     , quad(4)
+    , pass({ 1, ivec2(0,0), 1 })
+    , lattice(nullptr)
+    , mask(nullptr)
+    , masked(false)
+    , rendered_view(dvec2(0,0), 0.0, ivec2(0,0), 0)
+    , rendered_precision(PRECISION_FLOAT)
+    , keep_orbits(false)
+    , depth(0)
+    , continued_from(0)
+    , ladder({ PRECISION_FLOAT, PRECISION_DF64, PRECISION_DOUBLE, PRECISION_PERTURBATION })
+    , suggested_count(-1.0f)
+    , reference_buffer(sizeof(dvec2))
+    , series_buffer(sizeof(dvec2))
+    , bla_buffer(sizeof(BLAStep))
 {
     quad.vertex(-1,-1);
     quad.vertex( 1,-1);
     quad.vertex(-1, 1);
     quad.vertex( 1, 1);
     quad.send_data(false);
+}
 
-    shader.bind();
-    shader.set_uniform("max_iterations", (GLint)1024);
-    shader.unbind();
 
+Mandelbrot::~Mandelbrot()
+{
+    delete lattice;
+    delete mask;
+}
+
+
+void Mandelbrot::draw(const View& view)
+{
+    const Precision precision = ladder.select(view);
+
+    // Only perturbation renders with the reference, outside of it a finished
+    // one waits for the next get().
+    const bool new_reference = uses_reference(precision) && references.is_ready();
+
+    // Iterating is expensive, only redo it for a new view or reference.
+    if (view != rendered_view || precision != rendered_precision || new_reference) {
+        ivec2 shift;
+        double scale;
+        dvec2 offset;
+
+        // A running continuation leaves an image complete at the limit it started from
+        const bool complete = precision == rendered_precision && !new_reference && (schedule.is_done() || continued_from > 0);
+
+        if (complete && keep_orbits && view.has_same_pixels(rendered_view) && view.max_iterations >= rendered_view.max_iterations) {
+            // A higher limit only continues the pixels that reached the last one
+            if (view.max_iterations > depth) {
+                deepen(view.size, view.max_iterations);
+            }
+        } else if (complete && view.get_shift(rendered_view, shift)) {
+            // A pan only needs the strips it uncovered, see CPUMandelbrot::draw()
+            if (continued_from > 0) {
+                depth = continued_from;
+                continued_from = 0;
+            }
+
+            colorizer.shift_iterations(shift);
+            if (keep_orbits) orbits.shift(shift);
+            schedule.start(view.size, get_exposed_tiles(view.size, shift), tile_size);
+        } else {
+            // Other views show the last image until their tiles are done
+            if (view.get_reprojection(rendered_view, scale, offset)) {
+                colorizer.start_preview(scale, offset);
+            } else {
+                colorizer.clear_preview();
+            }
+
+            colorizer.clear_iterations(view.size);
+            schedule.start_progressive(view.size, tile_size);
+
+            keep_orbits = config.keep_orbits() && !uses_reference(precision);
+            depth = view.max_iterations;
+            continued_from = 0;
+
+            if (keep_orbits) orbits.resize(view.size);
+        }
+
+        rendered_view = view;
+        rendered_precision = precision;
+        suggested_count = -1.0f;
+    }
+
+    // Finished views catch up with their limit, then keep getting deeper
+    // while nothing else is to do
+    if (schedule.is_done() && keep_orbits && depth > 0) {
+        if (depth < view.max_iterations) {
+            deepen(view.size, view.max_iterations);
+        } else if (depth < config.deepen_limit()) {
+            deepen(view.size, minimum(2 * depth, config.deepen_limit()));
+        }
+    }
+
+    if (!schedule.is_done()) {
+        const Batch batch = schedule.next();
+
+        View target(view);
+        target.max_iterations = depth;
+
+        uint64_t start = nanotime();
+
+        pass = batch.pass;
+        regions = batch.tiles;
+
+        if (continued_from > 0) {
+            framebuffer.attach(colorizer.get_iterations(view.size));
+            framebuffer.bind();
+            draw_iterations(precision, target);
+            framebuffer.unbind();
+        } else if (batch.pass.step == 1) {
+            if (config.subdivision()) {
+                draw_subdivided(precision, target);
+            } else {
+                framebuffer.attach(colorizer.get_iterations(view.size));
+                framebuffer.bind();
+                draw_iterations(precision, target);
+                framebuffer.unbind();
+            }
+
+            // Glitches of coarse passes only last until this one
+            if (uses_reference(precision)) {
+                correct_glitches(target);
+                suggest_reference(target);
+            }
+        } else {
+            const View pass_view = target.get_lattice(batch.pass.step, batch.pass.phase);
+
+            // Passes render into the lower left part
+            const ivec2 size = pass_view.size;
 
-    const int W = 256*4;
-    GLfloat texdata[W];
-    for (int i=0; i < W; ++i) {
-        double x = i/double(W) * M_PI * 2.0;
-        texdata[i] = float(sin(x) * 0.5 + 0.5);
+            if (!lattice || lattice->width() < size.x || lattice->height() < size.y) {
+                delete lattice;
+                lattice = new GL::Texture(2,size.x,size.y,0,GL_RG,GL_RG32F,GL_NEAREST,GL_NEAREST,GL_CLAMP_TO_EDGE);
+            }
+
+            framebuffer.attach(*lattice);
+            framebuffer.bind();
+            glViewport(0,0, pass_view.size.x, pass_view.size.y);
+            draw_iterations(precision, pass_view);
+            glViewport(0,0, view.size.x, view.size.y);
+            framebuffer.unbind();
+
+            fill_blocks(batch.pass, batch.tiles, view.size);
+        }
+
+        // Wait for the GPU to measure how many tiles fit into a frame
+        if (config.frame_budget() > 0.0) {
+            glFinish();
+        }
+
+        schedule.finished(batch, (nanotime() - start) / (double)MILLION);
+
+        if (schedule.is_done()) {
+            continued_from = 0;
+        }
     }
 
-    texture = new GL::Texture(1,W,0,0,GL_RED,GL_R32F,GL_LINEAR,GL_LINEAR_MIPMAP_LINEAR,GL_REPEAT,0,texdata);
+    colorizer.draw();
 }
 
 
-Mandelbrot::~Mandelbrot()
+void Mandelbrot::deepen(const ivec2& size, int iterations)
+{
+    // Pixels a running continuation already passed resume from their new orbit point
+    if (continued_from == 0) {
+        continued_from = depth;
+    }
+
+    depth = iterations;
+    schedule.start_continuation(size, tile_size);
+}
+
+
+void Mandelbrot::draw_iterations(Precision precision, const View& view)
+{
+    switch (precision) {
+    case PRECISION_FLOAT:
+        draw_float(view); break;
+    case PRECISION_DF64:
+        draw_df64(view); break;
+    case PRECISION_DOUBLE:
+        draw_direct(view); break;
+    default:
+        draw_perturbation(view); break;
+    }
+}
+
+
+void Mandelbrot::draw_subdivided(Precision precision, const View& view)
 {
-    delete texture;
+    resize_mask(view.size);
+
+    framebuffer.attach(colorizer.get_iterations(view.size));
+
+    subdivide(0, view);
+
+    mask->bind();
+    masked = true;
+
+    framebuffer.bind();
+    draw_iterations(precision, view);
+    framebuffer.unbind();
+
+    subdivide(1, view);
+
+    framebuffer.bind();
+    draw_iterations(precision, view);
+    framebuffer.unbind();
+
+    masked = false;
+    mask->unbind();
 }
 
 
-void Mandelbrot::draw(const dvec2& focus, double mag)
+void Mandelbrot::subdivide(int stage, const View& view)
 {
-    dvec2 size_h = dvec2(config.window_size().x, config.window_size().y) * mag;
+    GL::Texture& iterations = colorizer.get_iterations(view.size);
+
+    subdivide_shader.bind();
+
+    glBindImageTexture(0, iterations.texture_name(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
+    glBindImageTexture(1, mask->texture_name(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
 
-    dmat3 view(size_h.x,0,0,
-               0,size_h.y,0,
-               focus.x,focus.y,1);
+    subdivide_shader.set_uniform("stage", (GLint)stage);
+    subdivide_shader.set_uniform("max_iterations", (GLint)view.max_iterations);
+    subdivide_shader.set_uniform("save_orbits", (GLint)keep_orbits);
+    if (keep_orbits) orbits.bind(subdivide_shader);
+
+    for (const Tile& tile : regions) {
+        subdivide_shader.set_uniform("tile", ivec4(tile.x, tile.y, tile.w, tile.h));
+        subdivide_shader.dispatch(round_up_div(tile.w, subdivision_block), round_up_div(tile.h, subdivision_block));
+    }
+
+    if (keep_orbits) orbits.unbind();
+
+    // Make the mask and the filled blocks visible to the iteration shader
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+    subdivide_shader.unbind();
+}
+
+
+void Mandelbrot::resize_mask(const ivec2& size)
+{
+    if (!mask || mask->width() != size.x || mask->height() != size.y) {
+        delete mask;
+        mask = new GL::Texture(2,size.x,size.y,0,GL_RED,GL_R8,GL_NEAREST,GL_NEAREST,GL_CLAMP_TO_EDGE);
+    }
+}
+
+
+void Mandelbrot::fill_blocks(const Pass& pass, const vector<Tile>& tiles, const ivec2& size)
+{
+    GL::Texture& iterations = colorizer.get_iterations(size);
+
+    lattice->bind();
+    fill_shader.bind();
+
+    glBindImageTexture(0, iterations.texture_name(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+
+    fill_shader.set_uniform("lattice", (const GL::Tex*)lattice);
+    fill_shader.set_uniform("step", (GLint)pass.step);
+    fill_shader.set_uniform("phase", pass.phase);
+    fill_shader.set_uniform("block", (GLint)pass.block);
+
+    for (const Tile& tile : tiles) {
+        fill_shader.set_uniform("tile", ivec4(tile.x, tile.y, tile.w, tile.h));
+        fill_shader.dispatch(round_up_div(tile.w, 8), round_up_div(tile.h, 8));
+    }
+
+    // Make the stores visible to the coloring pass and later copies
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+    fill_shader.unbind();
+    lattice->unbind();
+}
+
+
+void Mandelbrot::draw_regions(GL::Shader& shader)
+{
+    shader.set_uniform("masked", (GLint)masked);
+    if (masked) {
+        shader.set_uniform("mask", (const GL::Tex*)mask);
+    }
+
+    shader.set_uniform("save_orbits", (GLint)keep_orbits);
+    shader.set_uniform("continuing", (GLint)(continued_from > 0));
+    if (keep_orbits) {
+        shader.set_uniform("orbit_lattice", ivec4(pass.step, pass.phase.x, pass.phase.y, orbits.get_size().x));
+        orbits.bind(shader);
+    }
+
+    glEnable(GL_SCISSOR_TEST);
+
+    for (const Tile& region : regions) {
+        glScissor(region.x, region.y, region.w, region.h);
+        quad.draw(GL_TRIANGLE_STRIP, shader);
+    }
+
+    glDisable(GL_SCISSOR_TEST);
+
+    if (keep_orbits) {
+        orbits.unbind();
+    }
+}
+
+
+void Mandelbrot::draw_direct(const View& view)
+{
+    dvec2 size_h = dvec2(view.size) * view.mag.to_double();
+
+    dmat3 view_matrix(size_h.x,0,0,
+                      0,size_h.y,0,
+                      view.focus.x,view.focus.y,1);
 
-    texture->bind();
     shader.bind();
 
-    shader.set_uniform("view", view);
-    shader.set_uniform("tex", (const GL::Tex*)texture);
+    shader.set_uniform("view", view_matrix);
+    shader.set_uniform("max_iterations", (GLint)view.max_iterations);
+    shader.set_uniform("periodicity_check", (GLint)config.periodicity_check());
+    shader.set_uniform("periodicity_tolerance", view.pixel_spacing().to_double() * periodicity_tolerance_pixels);
     
-    quad.draw(GL_TRIANGLE_STRIP, shader);
+    draw_regions(shader);
         
     shader.unbind();
-    texture->unbind();
+}
+
+
+void Mandelbrot::draw_float(const View& view)
+{
+    const dvec2 size_h = dvec2(view.size) * view.mag.to_double();
+
+    const mat3 view_matrix(size_h.x,0,0,
+                           0,size_h.y,0,
+                           view.focus.x,view.focus.y,1);
+
+    float_shader.bind();
+
+    float_shader.set_uniform("view", view_matrix);
+    float_shader.set_uniform("max_iterations", (GLint)view.max_iterations);
+    float_shader.set_uniform("periodicity_check", (GLint)config.periodicity_check());
+    float_shader.set_uniform("periodicity_tolerance", (float)(view.pixel_spacing().to_double() * periodicity_tolerance_pixels));
+
+    draw_regions(float_shader);
+
+    float_shader.unbind();
+}
+
+
+void Mandelbrot::draw_df64(const View& view)
+{
+    const dvec2 size_h = dvec2(view.size) * view.mag.to_double();
+
+    df64_shader.bind();
+
+    df64_shader.set_uniform("center", vec4(split_double(view.focus.x), split_double(view.focus.y)));
+    df64_shader.set_uniform("half_size", vec2(size_h));
+    df64_shader.set_uniform("max_iterations", (GLint)view.max_iterations);
+    df64_shader.set_uniform("periodicity_check", (GLint)config.periodicity_check());
+    df64_shader.set_uniform("periodicity_tolerance", (float)(view.pixel_spacing().to_double() * periodicity_tolerance_pixels));
+
+    draw_regions(df64_shader);
+
+    df64_shader.unbind();
+}
+
+
+void Mandelbrot::draw_perturbation(const View& view)
+{
+    std::shared_ptr<const ReferenceOrbit> reference = references.get(view);
+
+    series.compute(*reference, get_probe_offsets(view, *reference), config.series_terms(), config.series_tolerance());
+
+    statistics.skip_iterations((uint64_t)series.get_skip() * view.size.x * view.size.y);
+
+    draw_reference(view, *reference, &series);
+}
+
+
+void Mandelbrot::draw_reference(const View& view, const ReferenceOrbit& reference, const SeriesApproximation* series)
+{
+    const vector<floatexp2> corners = get_corner_offsets(view, reference);
+    const int series_terms = series ? series->get_terms() : 0;
+
+    if (config.bla()) {
+        bla.compute(reference, get_max_offset(corners));
+    }
+
+    const size_t orbit_size = (reference.length() + 1) * sizeof(dvec2);
+
+    if (reference_buffer.get_size() < orbit_size) {
+        reference_buffer.resize(orbit_size);
+    }
+
+    reference_buffer.bind(GL_SHADER_STORAGE_BUFFER, 0);
+    reference_buffer.send_subdata((void*)reference.get_data(), 0, orbit_size);
+
+    const size_t series_size = maximum(series_terms, 1) * sizeof(dvec2);
+
+    if (series_buffer.get_size() < series_size) {
+        series_buffer.resize(series_size);
+    }
+
+    series_buffer.bind(GL_SHADER_STORAGE_BUFFER, 1);
+    if (series_terms > 0) {
+        series_buffer.send_subdata((void*)series->get_coefficients(), 0, series_terms * sizeof(dvec2));
+    }
+
+    const int bla_levels = config.bla() ? bla.get_levels() : 0;
+    const size_t bla_size = maximum(bla.get_size(), 1) * sizeof(BLAStep);
+
+    if (bla_buffer.get_size() < bla_size) {
+        bla_buffer.resize(bla_size);
+    }
+
+    bla_buffer.bind(GL_SHADER_STORAGE_BUFFER, 2);
+    if (bla_levels > 0) {
+        bla_buffer.send_subdata((void*)bla.get_data(), 0, bla.get_size() * sizeof(BLAStep));
+    }
+
+    perturbation_shader.bind();
+
+    perturbation_shader.set_buffer("reference_orbit", reference_buffer);
+    perturbation_shader.set_buffer("series_coefficients", series_buffer);
+    perturbation_shader.set_buffer("bla_steps", bla_buffer);
+    perturbation_shader.set_uniform("reference_length", (GLint)reference.length());
+    perturbation_shader.set_uniform("bla_levels", (GLint)bla_levels);
+    perturbation_shader.set_uniform("series_skip", (GLint)(series ? series->get_skip() : 0));
+    perturbation_shader.set_uniform("series_terms", (GLint)series_terms);
+    perturbation_shader.set_uniform("series_radius", series ? series->get_radius() : 0.0);
+    perturbation_shader.set_uniform("reference_point", dvec2(reference.get_re().to_double(), reference.get_im().to_double()));
+    // Offset and step as mantissas of a shared exponent, 0 while they fit.
+    const floatexp step = view.pixel_spacing();
+    const long scale = step.fits_double() ? 0 : step.e;
+
+    perturbation_shader.set_uniform("offset", (corners[0] * floatexp(1.0, -scale)).to_dvec2());
+    perturbation_shader.set_uniform("step", (step * floatexp(1.0, -scale)).to_double());
+    perturbation_shader.set_uniform("scale", (GLint)scale);
+    perturbation_shader.set_uniform("max_iterations", (GLint)view.max_iterations);
+    perturbation_shader.set_uniform("periodicity_check", (GLint)config.periodicity_check());
+    perturbation_shader.set_uniform("periodicity_tolerance", (step * periodicity_tolerance_pixels).to_double());
+
+    draw_regions(perturbation_shader);
+
+    perturbation_shader.unbind();
+
+    bla_buffer.unbind();
+    series_buffer.unbind();
+    reference_buffer.unbind();
+}
+
+
+void Mandelbrot::correct_glitches(const View& view)
+{
+    GL::Texture& iterations = colorizer.get_iterations(view.size);
+
+    glitch_pixels.resize(view.size);
+    resize_mask(view.size);
+
+    framebuffer.attach(iterations);
+
+    int glitched = -1;
+    int references = 1;
+
+    while (true) {
+        // Rows of the regions go straight into the rows of the buffer
+        framebuffer.bind();
+        glPixelStorei(GL_PACK_ROW_LENGTH, view.size.x);
+
+        for (const Tile& region : regions) {
+            glReadPixels(region.x, region.y, region.w, region.h, GL_RG, GL_FLOAT, glitch_pixels.row(region.y) + region.x);
+        }
+
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+        framebuffer.unbind();
+
+        if (glitched < 0) {
+            glitched = 0;
+
+            for (const Tile& region : regions) {
+                for (int y = region.y; y < region.y + region.h; ++y) {
+                    for (int x = region.x; x < region.x + region.w; ++x) {
+                        glitched += glitch_pixels.row(y)[x].has(PIXEL_GLITCHED);
+                    }
+                }
+            }
+        }
+
+        ivec2 pixel;
+
+        if (references >= config.max_references() || !find_glitch_center(glitch_pixels, regions, pixel)) {
+            break;
+        }
+
+        // The new reference is exact, only its distance to the pixels is rounded.
+        const floatexp2 offset = view.pixel_offset(pixel.x, pixel.y);
+
+        const BigFloat re = view.center_re + offset.x().to_bigfloat(BigFloat::limb_bits);
+        const BigFloat im = view.center_im + offset.y().to_bigfloat(BigFloat::limb_bits);
+
+        glitch_reference.compute(re, im, view.max_iterations, view.get_precision());
+        references++;
+
+        glitch_shader.bind();
+
+        glBindImageTexture(0, iterations.texture_name(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        glBindImageTexture(1, mask->texture_name(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8);
+
+        for (const Tile& region : regions) {
+            glitch_shader.set_uniform("tile", ivec4(region.x, region.y, region.w, region.h));
+            glitch_shader.dispatch(round_up_div(region.w, 8), round_up_div(region.h, 8));
+        }
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        glitch_shader.unbind();
+
+        mask->bind();
+        masked = true;
+
+        framebuffer.bind();
+        draw_reference(view, glitch_reference, NULL);
+        framebuffer.unbind();
+
+        masked = false;
+        mask->unbind();
+    }
+
+    statistics.count_glitches(glitched, references);
+}
+
+
+void Mandelbrot::suggest_reference(const View& view)
+{
+    for (const Tile& region : regions) {
+        for (int y = region.y; y < region.y + region.h; ++y) {
+            const Pixel* row = glitch_pixels.row(y);
+
+            for (int x = region.x; x < region.x + region.w; ++x) {
+                if (!row[x].has(PIXEL_GLITCHED) && !row[x].has(PIXEL_NOT_ITERATED) && row[x].count > suggested_count) {
+                    suggested_count = row[x].count;
+                    suggested_pixel = ivec2(x, y);
+                }
+            }
+        }
+    }
+
+    if (suggested_count < 0.0f) {
+        return;
+    }
+
+    const floatexp2 offset = view.pixel_offset(suggested_pixel.x, suggested_pixel.y);
+
+    references.suggest(view.center_re + offset.x().to_bigfloat(BigFloat::limb_bits),
+                       view.center_im + offset.y().to_bigfloat(BigFloat::limb_bits));
 }
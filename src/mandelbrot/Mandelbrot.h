@@ -4,22 +4,178 @@
 
 #include "Config.h"
 
+#include "GL/Buffer.h"
+#include "GL/ComputeShader.h"
+#include "GL/Framebuffer.h"
 #include "GL/Shader.h"
-#include "GL/Texture.h"
 #include "GL/VBO.h"
 
+#include "BLA.h"
+#include "Colorizer.h"
+#include "GPUOrbitBuffer.h"
+#include "IterationBuffer.h"
+#include "Perturbation.h"
+#include "Precision.h"
+#include "ReferenceCache.h"
+#include "TileSchedule.h"
+#include "View.h"
 
+
+/**
+ * GLSL renderer. The iteration pass renders the counts into the iteration
+ * texture of the colorizer and only runs for a new view, precision or
+ * reference, other frames only color the texture again. After a pan by
+ * whole pixels the texture is shifted and only the uncovered strips are
+ * iterated. Slow views are iterated over several frames and optionally in
+ * coarse passes first, see TileSchedule. The coarse passes render into a
+ * smaller texture which a compute shader spreads over the image. With
+ * subdivision enabled full resolution passes iterate the pixels in two
+ * rounds, see draw_subdivided(). Glitched perturbation pixels are rendered
+ * again from more references, see correct_glitches().
+ *
+ * Below perturbation the shaders save the last orbit point of the pixels
+ * that reach the limit in a GPUOrbitBuffer. A higher limit for the same
+ * pixels, and the deepening of finished views up to config.deepen_limit(),
+ * only continue those like in CPUMandelbrot.
+ */
 class Mandelbrot
 {
     
     GL::Shader shader;
+    GL::Shader float_shader;
+    GL::Shader df64_shader;
+    GL::Shader perturbation_shader;
+    GL::ComputeShader fill_shader;
+    GL::ComputeShader subdivide_shader;
+    GL::ComputeShader glitch_shader;
     GL::VBO quad;
-    GL::Texture* texture;
+    GL::Framebuffer framebuffer;
+    Colorizer colorizer;
+
+    TileSchedule schedule;
+    Pass pass;              /**< Pass of the current batch, places the fragments of coarse passes in the image. */
+    vector<Tile> regions;   /**< Tiles the current iteration pass covers. */
+    GL::Texture* lattice;   /**< Pixels of a coarse pass. */
+    GL::Texture* mask;      /**< Pixels the iteration shader skips while masked. */
+    bool masked;
+
+    View rendered_view;
+    Precision rendered_precision;
+
+    GPUOrbitBuffer orbits;
+    bool keep_orbits;       /**< rendered_view saves orbits. */
+    int depth;              /**< Iteration limit of the iteration texture, may be above the one of rendered_view. */
+    int continued_from;     /**< Limit the scheduled tiles are continued from, 0 if they are rendered. */
+
+    PrecisionLadder ladder;
+    ReferenceCache references;
+    ReferenceOrbit glitch_reference;
+    IterationBuffer glitch_pixels;  /**< Regions read back to find glitches in. */
+    ivec2 suggested_pixel;          /**< Pixel with the most iterations of the view so far. */
+    float suggested_count;          /**< Its count, -1 before the first full resolution pass. */
+    SeriesApproximation series;
+    BLATable bla;
+    GL::Buffer reference_buffer;
+    GL::Buffer series_buffer;
+    GL::Buffer bla_buffer;
     
     public:
 
     Mandelbrot();
     ~Mandelbrot();
     
-    void draw(const dvec2& focus, double mag);
+    void draw(const View& view);
+
+    /**
+     * True while a better reference orbit is computed in the background.
+     */
+    bool is_refining() const { return references.is_pending(); }
+
+    /**
+     * True while tiles of the current view are still to be iterated.
+     */
+    bool is_incomplete() const { return !schedule.is_done(); }
+
+    private:
+
+    /**
+     * Continue the pixels that reached the current limit up to a higher one,
+     * like CPUMandelbrot::deepen().
+     */
+    void deepen(const ivec2& size, int iterations);
+
+    /**
+     * Render the regions of view into the bound framebuffer.
+     */
+    void draw_iterations(Precision precision, const View& view);
+
+    /**
+     * Render the regions of a full resolution pass by subdivision into the
+     * iteration texture. The first round iterates the border and the middle
+     * row and column of blocks of the regions. Blocks where all of them are
+     * interior are filled, the rest of the others is iterated in the second
+     * round. The iteration shaders skip the pixels of the mask texture,
+     * which subdivide.compute sets up before each round.
+     */
+    void draw_subdivided(Precision precision, const View& view);
+
+    /**
+     * Run one stage of subdivide.compute over the regions.
+     */
+    void subdivide(int stage, const View& view);
+
+    /**
+     * Resize the mask texture to the view.
+     */
+    void resize_mask(const ivec2& size);
+
+    /**
+     * Copy the tiles of a coarse pass from the lattice texture into the
+     * iteration texture, see ::fill_blocks().
+     */
+    void fill_blocks(const Pass& pass, const vector<Tile>& tiles, const ivec2& size);
+
+    /**
+     * Draw the quad with the iteration shader over the regions.
+     */
+    void draw_regions(GL::Shader& shader);
+
+    void draw_direct(const View& view);
+    void draw_float(const View& view);
+
+    /**
+     * Float pair (df64) variant of the direct path for GPUs with slow doubles.
+     */
+    void draw_df64(const View& view);
+
+    /**
+     * Deep zoom path. The reference orbit is computed on the CPU and read by
+     * the fragment shader from a shader storage buffer.
+     */
+    void draw_perturbation(const View& view);
+
+    /**
+     * Draw the regions with the perturbation shader relative to reference.
+     *
+     * @param series Lets the pixels skip iterations, or NULL.
+     */
+    void draw_reference(const View& view, const ReferenceOrbit& reference, const SeriesApproximation* series);
+
+    /**
+     * Render the glitched pixels of a full resolution perturbation pass
+     * again, each round from a new reference at the middle of the largest
+     * glitched area, until none are left or config.max_references() are
+     * used. Like CPURenderer::correct_glitches() but the shader keeps no
+     * glitch depth, so the iteration texture is read back to pick the
+     * reference. The other pixels are masked like in draw_subdivided().
+     */
+    void correct_glitches(const View& view);
+
+    /**
+     * Propose the pixel with the most iterations of the full resolution
+     * passes of view so far as the next reference, like
+     * CPURenderer::suggest_reference(). Takes the regions from the pixels
+     * correct_glitches() read back last and skips those still glitched.
+     */
+    void suggest_reference(const View& view);
 };
@@ -0,0 +1,93 @@
+#include "OrbitBuffer.h"
+
+#include "Statistics.h"
+
+#include <algorithm>
+
+
+/**
+ * Copy w elements between rows that may overlap.
+ */
+template <typename T>
+static void move_row(const T* src, T* dst, int w)
+{
+    if (dst < src) {
+        std::copy(src, src + w, dst);
+    } else {
+        std::copy_backward(src, src + w, dst + w);
+    }
+}
+
+
+/**
+ * Row move of IterationBuffer::shift() for one of the arrays.
+ */
+template <typename T>
+static void shift_rows(vector<T>& data, const ivec2& size, const ivec2& offset)
+{
+    const int w = size.x - abs(offset.x);
+    const int h = size.y - abs(offset.y);
+
+    const int src_x = maximum(offset.x, 0);
+    const int dst_x = maximum(-offset.x, 0);
+
+    if (offset.y >= 0) {
+        for (int y = 0; y < h; ++y) {
+            move_row(&data[(y + offset.y) * size.x + src_x], &data[y * size.x + dst_x], w);
+        }
+    } else {
+        for (int y = h - 1; y >= 0; --y) {
+            move_row(&data[y * size.x + src_x], &data[(y - offset.y) * size.x + dst_x], w);
+        }
+    }
+}
+
+
+OrbitBuffer::OrbitBuffer()
+    : size(0,0)
+{
+}
+
+
+OrbitBuffer::~OrbitBuffer()
+{
+    statistics.free_orbit_memory(get_memory());
+}
+
+
+void OrbitBuffer::resize(const ivec2& new_size)
+{
+    if (new_size == size) return;
+
+    statistics.free_orbit_memory(get_memory());
+
+    size = new_size;
+    z.resize(size.x * size.y);
+    iterations.assign(size.x * size.y, 0);
+
+    statistics.alloc_orbit_memory(get_memory());
+}
+
+
+void OrbitBuffer::clear(const Tile& tile)
+{
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+        std::fill_n(&iterations[y * size.x + tile.x], tile.w, 0);
+    }
+}
+
+
+void OrbitBuffer::shift(const ivec2& offset)
+{
+    if (abs(offset.x) >= size.x || abs(offset.y) >= size.y) {
+        clear({ 0, 0, size.x, size.y });
+        return;
+    }
+
+    shift_rows(z, size, offset);
+    shift_rows(iterations, size, offset);
+
+    for (const Tile& tile : get_exposed_tiles(size, offset)) {
+        clear(tile);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common.h"
+
+#include "Kernel.h"
+
+
+/**
+ * Iteration count of the orbits that never escape, see OrbitBuffer.
+ */
+static const int orbit_settled = -1;
+
+
+/**
+ * Last orbit point of the pixels that reached the iteration limit, so a
+ * higher limit continues them instead of starting over at z0. Each pixel
+ * keeps z and the iteration it belongs to. 0 iterations start over, pixels
+ * in the main bulbs or caught in a cycle are settled and never continued.
+ * Rows are stored bottom to top like in IterationBuffer. Takes 20 bytes per
+ * pixel, which Statistics reports.
+ */
+class OrbitBuffer : public noncopyable
+{
+    ivec2 size;
+    vector<dvec2> z;
+    vector<int> iterations;
+
+    public:
+
+    OrbitBuffer();
+    ~OrbitBuffer();
+
+    void resize(const ivec2& new_size);
+
+    const ivec2& get_size() const { return size; }
+
+    /**
+     * Let the pixels of tile start over.
+     */
+    void clear(const Tile& tile);
+
+    /**
+     * Move the contents like IterationBuffer::shift(), uncovered pixels
+     * start over.
+     */
+    void shift(const ivec2& offset);
+
+    const dvec2& get_z(int x, int y) const { return z[y * size.x + x]; }
+    int get_iterations(int x, int y) const { return iterations[y * size.x + x]; }
+
+    void save(int x, int y, const dvec2& point, int count)
+    {
+        z[y * size.x + x] = point;
+        iterations[y * size.x + x] = count;
+    }
+
+    void settle(int x, int y) { iterations[y * size.x + x] = orbit_settled; }
+
+    size_t get_memory() const { return z.size() * sizeof(dvec2) + iterations.size() * sizeof(int); }
+};
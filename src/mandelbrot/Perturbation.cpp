@@ -0,0 +1,486 @@
+#include "Perturbation.h"
+
+#include "BLA.h"
+#include "Statistics.h"
+
+#include <atomic>
+
+
+static std::atomic<int> next_reference_id(1);
+
+
+ReferenceOrbit::ReferenceOrbit()
+    : escaped(false)
+    , max_iterations(0)
+    , precision(0)
+    , id(0)
+{
+}
+
+
+void ReferenceOrbit::compute(const BigFloat& re, const BigFloat& im, int max_iterations, int precision)
+{
+    this->re = re;
+    this->im = im;
+    this->max_iterations = max_iterations;
+    this->precision = precision;
+    this->id = next_reference_id++;
+
+    orbit.clear();
+    orbit.reserve(max_iterations + 1);
+    escaped = false;
+
+    BigFloat cr(re), ci(im);
+    cr.set_precision(precision);
+    ci.set_precision(precision);
+
+    BigFloat zr(precision), zi(precision);
+    BigFloat zr2(precision), zi2(precision);
+
+    orbit.push_back(dvec2(0,0));
+
+    for (int n = 0; n < max_iterations; ++n) {
+        // z = z^2 + c with squarings only, 2 zr zi = (zr + zi)^2 - zr^2 - zi^2
+        zr2 = zr;
+        zr2.square();
+        zi2 = zi;
+        zi2.square();
+
+        zi += zr;
+        zi.square();
+        zi -= zr2;
+        zi -= zi2;
+        zi += ci;
+
+        zr = zr2;
+        zr -= zi2;
+        zr += cr;
+
+        const dvec2 z(zr.to_double(), zi.to_double());
+        orbit.push_back(z);
+
+        if (glm::dot(z,z) >= 4.0) {
+            escaped = true;
+            break;
+        }
+    }
+}
+
+
+static dvec2 evaluate_series(const vector<dvec2>& coefficients, const dvec2& u)
+{
+    dvec2 sum(0,0);
+
+    for (int k = (int)coefficients.size() - 1; k >= 0; --k) {
+        sum = cmul(sum + coefficients[k], u);
+    }
+
+    return sum;
+}
+
+
+SeriesApproximation::SeriesApproximation()
+    : radius(0.0)
+    , skip(0)
+    , reference_id(0)
+    , terms(0)
+    , tolerance(0.0)
+{
+}
+
+
+void SeriesApproximation::compute(const ReferenceOrbit& Z, const vector<floatexp2>& exact_probes, int terms, double tolerance)
+{
+    // Without probes in the double range the radius is 0 and nothing skipped.
+    vector<dvec2> probes;
+
+    if (get_max_offset(exact_probes).fits_double()) {
+        for (size_t i = 0; i < exact_probes.size(); ++i) {
+            probes.push_back(exact_probes[i].to_dvec2());
+        }
+    }
+
+    if (Z.get_id() == reference_id && probes == this->probes &&
+        terms == this->terms && tolerance == this->tolerance) {
+        return;
+    }
+
+    reference_id = Z.get_id();
+    this->probes = probes;
+    this->terms = terms;
+    this->tolerance = tolerance;
+
+    coefficients.clear();
+    radius = 0.0;
+    skip = 0;
+
+    for (size_t i = 0; i < probes.size(); ++i) {
+        radius = maximum(radius, glm::length(probes[i]));
+    }
+
+    if (terms <= 0 || radius == 0.0) {
+        return;
+    }
+
+    // B_k = A_k * radius^k, so the series is evaluated at |u| <= 1.
+    vector<dvec2> b(terms, dvec2(0,0));
+    vector<dvec2> next(terms);
+
+    vector<dvec2> delta(probes.size(), dvec2(0,0));
+
+    for (int n = 0; n < Z.length(); ++n) {
+        const dvec2 z2 = 2.0 * Z[n];
+
+        // A_1' = 2 Z A_1 + 1,  A_k' = 2 Z A_k + sum_{j+l=k} A_j A_l
+        next[0] = cmul(z2, b[0]) + dvec2(radius, 0);
+        for (int k = 1; k < terms; ++k) {
+            dvec2 sum = cmul(z2, b[k]);
+            for (int j = 0; j < k; ++j) {
+                sum += cmul(b[j], b[k-1-j]);
+            }
+            next[k] = sum;
+        }
+
+        for (size_t i = 0; i < probes.size(); ++i) {
+            delta[i] = cmul(z2 + delta[i], delta[i]) + probes[i];
+        }
+
+        // Every pixel must still be inside the escape radius after the skip.
+        double bound = 0.0;
+        for (int k = 0; k < terms; ++k) {
+            bound += glm::length(next[k]);
+        }
+
+        if (glm::length(Z[n+1]) + bound >= 2.0) {
+            break;
+        }
+
+        // The first omitted term is about as large as the last one, it
+        // must be negligible against the linear term at |u| = 1.
+        if (glm::length(next[terms-1]) > tolerance * glm::length(next[0])) {
+            break;
+        }
+
+        bool valid = true;
+        for (size_t i = 0; i < probes.size() && valid; ++i) {
+            const dvec2 approximation = evaluate_series(next, probes[i] / radius);
+            valid = glm::length(approximation - delta[i]) <= tolerance * glm::length(delta[i]);
+        }
+
+        if (!valid) {
+            break;
+        }
+
+        b.swap(next);
+        skip = n + 1;
+    }
+
+    coefficients = b;
+}
+
+
+dvec2 SeriesApproximation::evaluate(const dvec2& dc) const
+{
+    if (skip == 0) {
+        return dvec2(0,0);
+    }
+
+    return evaluate_series(coefficients, dc / radius);
+}
+
+
+vector<floatexp2> get_corner_offsets(const View& view, const ReferenceOrbit& reference)
+{
+    const floatexp2 center = reference.get_offset(view.center_re, view.center_im);
+
+    vector<floatexp2> corners;
+
+    corners.push_back(center + view.pixel_offset(0, 0));
+    corners.push_back(center + view.pixel_offset(view.size.x - 1, 0));
+    corners.push_back(center + view.pixel_offset(0, view.size.y - 1));
+    corners.push_back(center + view.pixel_offset(view.size.x - 1, view.size.y - 1));
+
+    return corners;
+}
+
+
+/**
+ * Probe points per row and column of get_probe_offsets().
+ */
+static const int probe_grid = 5;
+
+
+vector<floatexp2> get_probe_offsets(const View& view, const ReferenceOrbit& reference)
+{
+    const floatexp2 center = reference.get_offset(view.center_re, view.center_im);
+
+    vector<floatexp2> probes;
+
+    for (int j = 0; j < probe_grid; ++j) {
+        for (int i = 0; i < probe_grid; ++i) {
+            const int x = i * (view.size.x - 1) / (probe_grid - 1);
+            const int y = j * (view.size.y - 1) / (probe_grid - 1);
+
+            probes.push_back(center + view.pixel_offset(x, y));
+        }
+    }
+
+    return probes;
+}
+
+
+floatexp get_max_offset(const vector<floatexp2>& offsets)
+{
+    floatexp radius = 0.0;
+
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        radius = maximum(radius, offsets[i].length());
+    }
+
+    return radius;
+}
+
+
+floatexp2 ReferenceOrbit::get_offset(const BigFloat& other_re, const BigFloat& other_im) const
+{
+    return floatexp2(floatexp(other_re - re), floatexp(other_im - im));
+}
+
+
+GlitchMap::GlitchMap()
+    : size(0,0)
+{
+}
+
+
+void GlitchMap::reset(const ivec2& new_size)
+{
+    size = new_size;
+    depth.assign(size.x * size.y, -1.0f);
+}
+
+
+int GlitchMap::count() const
+{
+    int glitched = 0;
+
+    for (size_t i = 0; i < depth.size(); ++i) {
+        if (depth[i] >= 0.0f) glitched++;
+    }
+
+    return glitched;
+}
+
+
+bool GlitchMap::find_reference(ivec2& pixel) const
+{
+    int best = -1;
+
+    for (size_t i = 0; i < depth.size(); ++i) {
+        if (depth[i] >= 0.0f && (best < 0 || depth[i] < depth[best])) {
+            best = (int)i;
+        }
+    }
+
+    if (best < 0) {
+        return false;
+    }
+
+    pixel = ivec2(best % size.x, best / size.x);
+    return true;
+}
+
+
+// Pauldelbrot's criterion: |Z + delta| < 1e-3 |Z|, compared squared.
+static const double glitch_tolerance = 1e-6;
+
+
+/**
+ * Iterate a pixel in floatexp until its delta grows into the double range.
+ * Z + delta is just Z until then, so there are no glitches to look for.
+ * @return Iteration the double precision loop continues at.
+ */
+static int iterate_floatexp(const PerturbationArgs& args, const floatexp2& dc, floatexp2& d)
+{
+    const ReferenceOrbit& Z = *args.reference;
+    const int end = minimum(args.max_iterations, Z.length());
+
+    if (end <= 0) {
+        return 0;
+    }
+
+    // delta_1 = delta_c, since Z_0 = delta_0 = 0.
+    d = dc;
+    int it = 1;
+
+    while (it < end && !d.fits_double()) {
+        if (glm::dot(Z[it], Z[it]) >= 4.0) break;
+
+        // Tiny deltas round to zero here, which only passes steps whose
+        // radius is no tinier.
+        const BLAStep* step;
+        const int skip = args.bla ? args.bla->lookup(it, d.to_dvec2(), step) : 0;
+
+        if (skip > 0) {
+            d = step->a * d + step->b * dc;
+            it += skip;
+            continue;
+        }
+
+        d = (2.0 * Z[it]) * d + d * d + dc;
+        it++;
+    }
+
+    return it;
+}
+
+
+void perturbation_kernel(const PerturbationArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    const ReferenceOrbit& Z = *args.reference;
+    const int length = Z.length();
+
+    // Views within the double range never need floatexp.
+    const bool deep = !args.step.fits_double();
+    const dvec2 offset = args.offset.to_dvec2();
+    const double step = args.step.to_double();
+
+    // Deep pixels collapse onto the reference in double precision, good
+    // enough to tell the main cardioid or period-2 bulb.
+    const dvec2 center(Z.get_re().to_double(), Z.get_im().to_double());
+
+    int periodic = 0;
+
+    for (int y = tile.y; y < tile.y + tile.h; ++y) {
+        Pixel* out = buffer.row(y);
+
+        for (int x = tile.x; x < tile.x + tile.w; ++x) {
+            if (args.glitched_only && !args.glitches->is_glitched(x, y)) continue;
+
+            const ivec2 pixel = args.lattice.get_pixel(x, y);
+
+            double dcx = offset.x + pixel.x * step;
+            double dcy = offset.y + pixel.y * step;
+
+            if (in_main_bulbs(center.x + dcx, center.y + dcy)) {
+                args.glitches->set_good(x, y);
+                out[x] = interior_pixel(args.max_iterations);
+                continue;
+            }
+
+            int it = 0;
+            double dx = 0, dy = 0;
+            float glitch_depth = -1.0f;
+            bool cycle = false;
+
+            if (deep) {
+                // delta_c may round to zero in double, but by the time the
+                // delta fits it dwarfs delta_c anyway.
+                const floatexp2 dc = args.offset + floatexp2(dvec2(pixel), 0) * args.step;
+                floatexp2 d;
+
+                it = iterate_floatexp(args, dc, d);
+
+                dcx = dc.to_dvec2().x;
+                dcy = dc.to_dvec2().y;
+                dx = d.to_dvec2().x;
+                dy = d.to_dvec2().y;
+            } else if (args.series) {
+                const dvec2 d = args.series->evaluate(dvec2(dcx, dcy));
+                it = args.series->get_skip();
+                dx = d.x;
+                dy = d.y;
+            }
+
+            // Brent's cycle detection, see PeriodicityCheck
+            int saved = it;
+            dvec2 saved_delta(dx, dy);
+            int compares = 0;
+            int window = 1;
+            int next_check = args.periodicity_check > 0 ? it + args.periodicity_check : args.max_iterations + 1;
+
+            while (it < args.max_iterations && it < length) {
+                const double Zx = Z[it].x;
+                const double Zy = Z[it].y;
+
+                const double zx = Zx + dx;
+                const double zy = Zy + dy;
+                const double z2 = zx*zx + zy*zy;
+
+                if (z2 >= 4.0) break;
+
+                const double Z2 = Zx*Zx + Zy*Zy;
+
+                if (z2 < glitch_tolerance * Z2) {
+                    glitch_depth = (float)(z2 / Z2);
+                    break;
+                }
+
+                if (it >= next_check) {
+                    // BLA steps may have passed several checks
+                    next_check += (it - next_check) / args.periodicity_check * args.periodicity_check + args.periodicity_check;
+
+                    const dvec2 d = (Z[it] - Z[saved]) + (dvec2(dx, dy) - saved_delta);
+
+                    if (is_near(d.x, d.y, args.periodicity_tolerance)) {
+                        cycle = true;
+                        ++periodic;
+                        break;
+                    }
+
+                    if (++compares == window) {
+                        saved = it;
+                        saved_delta = dvec2(dx, dy);
+                        compares = 0;
+                        window *= 2;
+                    }
+                }
+
+                const BLAStep* step;
+                const int skip = args.bla ? args.bla->lookup(it, dvec2(dx, dy), step) : 0;
+
+                if (skip > 0) {
+                    const dvec2 d = cmul(step->a, dvec2(dx, dy)) + cmul(step->b, dvec2(dcx, dcy));
+                    dx = d.x;
+                    dy = d.y;
+                    it += skip;
+                    continue;
+                }
+
+                // delta' = (2Z + delta) * delta + delta_c
+                const double tx = 2.0*Zx + dx;
+                const double ty = 2.0*Zy + dy;
+
+                const double ndx = tx*dx - ty*dy + dcx;
+                const double ndy = tx*dy + ty*dx + dcy;
+
+                dx = ndx;
+                dy = ndy;
+                it++;
+            }
+
+            if (cycle) {
+                args.glitches->set_good(x, y);
+                out[x] = interior_pixel(args.max_iterations);
+                continue;
+            }
+
+            const dvec2 z = Z[it] + dvec2(dx, dy);
+
+            if (glitch_depth < 0.0f && it == length && length < args.max_iterations && glm::dot(z,z) < 4.0) {
+                // The reference escaped first, nothing left to compare with.
+                glitch_depth = 1.0f;
+            }
+
+            if (glitch_depth < 0.0f) {
+                args.glitches->set_good(x, y);
+                out[x] = orbit_pixel(it, args.max_iterations, glm::dot(z,z));
+            } else {
+                args.glitches->set_glitched(x, y, glitch_depth);
+                out[x] = { (float)it, (float)PIXEL_GLITCHED };
+            }
+        }
+    }
+
+    statistics.count_periodic(periodic);
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include "common.h"
+
+#include "BigFloat.h"
+
+#include "FloatExp.h"
+#include "IterationBuffer.h"
+#include "Kernel.h"
+#include "View.h"
+
+
+class BLATable;
+
+
+inline dvec2 cmul(const dvec2& a, const dvec2& b)
+{
+    return dvec2(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+
+/**
+ * Orbit Z_n of a reference point, iterated in arbitrary precision and
+ * rounded to double. Pixels near the reference only iterate their small
+ * difference to this orbit, which double precision resolves at any depth.
+ */
+class ReferenceOrbit
+{
+    vector<dvec2> orbit;
+    bool escaped;
+
+    BigFloat re, im;
+    int max_iterations;
+    int precision;
+    int id;
+
+    public:
+
+    ReferenceOrbit();
+
+    /**
+     * Iterate the reference point until it escapes or hits max_iterations.
+     * @param precision Mantissa bits used for the iteration.
+     */
+    void compute(const BigFloat& re, const BigFloat& im, int max_iterations, int precision);
+
+    const BigFloat& get_re() const { return re; }
+    const BigFloat& get_im() const { return im; }
+    int get_max_iterations() const { return max_iterations; }
+    int get_precision() const { return precision; }
+
+    /**
+     * Unique for every computed orbit, lets derived data detect a new one.
+     */
+    int get_id() const { return id; }
+
+    /**
+     * Distance from the reference to the point (re, im).
+     */
+    floatexp2 get_offset(const BigFloat& re, const BigFloat& im) const;
+
+    /**
+     * True if the orbit covers max_iterations.
+     */
+    bool covers(int max_iterations) const { return escaped || this->max_iterations >= max_iterations; }
+
+    /**
+     * Number of iterations available. Z_0 ... Z_length() are valid.
+     */
+    int length() const { return (int)orbit.size() - 1; }
+
+    /**
+     * True if the reference escaped before reaching the iteration limit.
+     */
+    bool has_escaped() const { return escaped; }
+
+    const dvec2& operator[] (int n) const { return orbit[n]; }
+
+    const dvec2* get_data() const { return orbit.data(); }
+};
+
+
+/**
+ * Truncated power series delta_n = sum_k A_k(n) delta_c^k fitted along the
+ * reference orbit. Every pixel can start at iteration get_skip() with the
+ * series value instead of iterating from zero. The coefficients are stored
+ * scaled by radius^k so they stay in range, but the radius itself has to be
+ * a double. Deeper views get no skip.
+ */
+class SeriesApproximation
+{
+    vector<dvec2> coefficients;
+    double radius;
+    int skip;
+
+    int reference_id;
+    vector<dvec2> probes;
+    int terms;
+    double tolerance;
+
+    public:
+
+    SeriesApproximation();
+
+    /**
+     * Advance the series along the reference as long as it matches the
+     * actually iterated probe points. Does nothing if neither the reference
+     * nor the parameters changed since the last call.
+     * @param probes Offsets of the probe points from the reference, see
+     *               get_probe_offsets().
+     * @param terms Number of series terms. 0 disables skipping.
+     * @param tolerance Largest accepted relative error at the probes.
+     */
+    void compute(const ReferenceOrbit& reference, const vector<floatexp2>& probes, int terms, double tolerance);
+
+    /**
+     * Number of iterations all pixels may skip.
+     */
+    int get_skip() const { return skip; }
+
+    int get_terms() const { return (int)coefficients.size(); }
+    double get_radius() const { return radius; }
+    const dvec2* get_coefficients() const { return coefficients.data(); }
+
+    /**
+     * Delta of a pixel after get_skip() iterations.
+     */
+    dvec2 evaluate(const dvec2& dc) const;
+};
+
+
+/**
+ * Offsets of the four corner pixels of a view from the reference.
+ */
+vector<floatexp2> get_corner_offsets(const View& view, const ReferenceOrbit& reference);
+
+/**
+ * Offsets of a grid of pixels spread evenly over a view from the reference,
+ * including the corners and edges. The probe points for
+ * SeriesApproximation::compute.
+ */
+vector<floatexp2> get_probe_offsets(const View& view, const ReferenceOrbit& reference);
+
+/**
+ * Largest |delta_c| among the offsets.
+ */
+floatexp get_max_offset(const vector<floatexp2>& offsets);
+
+
+/**
+ * Pixels whose perturbation result can't be trusted.
+ * For each glitched pixel the map keeps |z|^2 / |Z|^2 at the iteration the
+ * glitch was detected. The pixel with the smallest value lies closest to the
+ * structure the reference missed and is a good spot for a new reference.
+ */
+class GlitchMap
+{
+    ivec2 size;
+    vector<float> depth;
+
+    public:
+
+    GlitchMap();
+
+    /**
+     * Resize and mark all pixels as good.
+     */
+    void reset(const ivec2& new_size);
+
+    bool is_glitched(int x, int y) const { return depth[y * size.x + x] >= 0.0f; }
+
+    void set_glitched(int x, int y, float glitch_depth) { depth[y * size.x + x] = glitch_depth; }
+    void set_good(int x, int y) { depth[y * size.x + x] = -1.0f; }
+
+    int count() const;
+
+    /**
+     * Pick the pixel for the next reference.
+     * @return false if no pixel is glitched.
+     */
+    bool find_reference(ivec2& pixel) const;
+};
+
+
+/**
+ * Parameters of the perturbation kernel.
+ * Image pixel (x,y) lies at reference + offset + (x,y) * step.
+ */
+struct PerturbationArgs
+{
+    const ReferenceOrbit* reference;
+    const SeriesApproximation* series;
+    const BLATable* bla;
+
+    floatexp2 offset;      /**< Image pixel (0,0) relative to the reference. */
+    floatexp step;
+    int max_iterations;
+    Lattice lattice;       /**< Image pixels the buffer holds, all by default. */
+
+    int periodicity_check;          /**< Iterations between cycle checks, 0 disables them. */
+    double periodicity_tolerance;   /**< Distance at which orbit samples count as equal. */
+
+    GlitchMap* glitches;   /**< Receives the glitched pixels. */
+    bool glitched_only;    /**< Only render pixels already marked in glitches. */
+};
+
+
+/**
+ * Iterate delta_{n+1} = 2 Z_n delta_n + delta_n^2 + delta_c for all pixels in
+ * a tile. Pixels where the reference is a poor fit (Pauldelbrot's criterion
+ * |Z_n + delta_n| << |Z_n|) and pixels that outlive the reference orbit are
+ * marked in the glitch map and need another reference. Deltas below the
+ * double range start out as floatexp and switch to doubles once they grew
+ * large enough. Like the other kernels the doubles loop checks the orbit
+ * Z + delta for cycles, the distance between samples Z_n + delta_n and
+ * Z_m + delta_m is taken as (Z_n - Z_m) + (delta_n - delta_m), which keeps
+ * the precision of the deltas. BLA steps may pass a check, the next one
+ * then comes at the next multiple of periodicity_check.
+ */
+void perturbation_kernel(const PerturbationArgs& args, const Tile& tile, IterationBuffer& buffer);
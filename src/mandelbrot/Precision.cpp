@@ -0,0 +1,106 @@
+#include "Precision.h"
+
+#include "Config.h"
+#include "Statistics.h"
+
+#include <limits>
+
+
+struct PrecisionTier
+{
+    const char* name;
+    double max_bits;    /**< Largest get_required_bits() the tier renders correctly. */
+};
+
+
+/**
+ * Rounding errors grow over the iterations, so each tier keeps about 12 of
+ * its mantissa bits as a guard. The limits are in get_required_bits(), which
+ * counts pixel spacings rather than mag (half a pixel spacing). Near the
+ * origin the 41 bits of double end at a spacing of 2^-40 = 9.1e-13, which is
+ * mag 4.5e-13, somewhat deeper than the old switch to perturbation at mag
+ * 1e-12. The fixed point limit of 86 bits is the measured mag 1e-26 (spacing
+ * 2e-26) of the 128-bit kernel.
+ */
+static const PrecisionTier precision_tiers[] = {
+    { "float",                 24 - 12 },
+    { "double",                53 - 12 },
+    { "df64",                  48 - 12 },
+    { "long_double",           64 - 12 },
+    { "fixed128",              86 },
+    { "float128",              113 - 12 },
+    { "perturbation",          std::numeric_limits<double>::infinity() },
+    { "perturbation floatexp", std::numeric_limits<double>::infinity() },
+};
+
+
+const char* get_precision_name(Precision precision)
+{
+    return precision_tiers[precision].name;
+}
+
+
+/**
+ * Orbits of the set reach |z| = 2 no matter where c is, so centers close to
+ * the origin don't buy any precision.
+ */
+double get_required_bits(const View& view)
+{
+    const double scale = maximum(maximum(fabs(view.focus.x), fabs(view.focus.y)), 2.0);
+
+    return std::log2(scale) - view.pixel_spacing().log2();
+}
+
+
+static bool is_enabled(Precision precision)
+{
+    switch (precision) {
+    case PRECISION_DF64:
+        return config.df64();
+    case PRECISION_LONG_DOUBLE:
+        return config.long_double();
+    case PRECISION_FLOAT128:
+        return config.float128();
+    case PRECISION_FIXED128:
+        return config.fixed_point();
+    default:
+        return true;
+    }
+}
+
+
+PrecisionLadder::PrecisionLadder(std::initializer_list<Precision> tiers)
+    : tiers(tiers)
+{
+}
+
+
+Precision PrecisionLadder::select(const View& view) const
+{
+    const double bits = get_required_bits(view);
+    Precision result = tiers.back();
+
+    for (Precision precision : tiers) {
+        if (is_enabled(precision) && bits <= precision_tiers[precision].max_bits) {
+            result = precision;
+            break;
+        }
+    }
+
+    // A tier forced in the config wins if the engine offers it
+    for (Precision precision : tiers) {
+        if (config.precision() == get_precision_name(precision)) {
+            result = precision;
+        }
+    }
+
+    // Both engines take the floatexp path by themselves once the pixel
+    // spacing leaves the double range.
+    if (result == PRECISION_PERTURBATION && !view.pixel_spacing().fits_double()) {
+        result = PRECISION_PERTURBATION_FLOATEXP;
+    }
+
+    statistics.set_precision(get_precision_name(result), bits);
+
+    return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "common.h"
+
+#include "View.h"
+
+#include <initializer_list>
+
+
+/**
+ * Arithmetic a view can be rendered with, roughly from cheapest to most
+ * capable.
+ */
+enum Precision
+{
+    PRECISION_FLOAT,
+    PRECISION_DOUBLE,
+    PRECISION_DF64,
+    PRECISION_LONG_DOUBLE,
+    PRECISION_FIXED128,
+    PRECISION_FLOAT128,
+    PRECISION_PERTURBATION,          /**< Double deltas to a reference orbit. */
+    PRECISION_PERTURBATION_FLOATEXP, /**< floatexp deltas below the double range. */
+};
+
+
+const char* get_precision_name(Precision precision);
+
+
+/**
+ * True for the tiers that render relative to a reference orbit.
+ */
+inline bool uses_reference(Precision precision)
+{
+    return precision >= PRECISION_PERTURBATION;
+}
+
+
+/**
+ * Significant bits needed to tell neighbouring pixels apart, the magnitude
+ * of the center coordinates relative to the pixel spacing.
+ */
+double get_required_bits(const View& view);
+
+
+/**
+ * Picks the cheapest arithmetic that still resolves a view from the tiers
+ * an engine offers, and reports switches to Statistics.
+ * df64 and the CPU tiers between double and perturbation are only
+ * considered while their config options are on.
+ * The config option precision can force a tier for comparisons.
+ */
+class PrecisionLadder
+{
+    vector<Precision> tiers;
+
+    public:
+
+    /**
+     * @param tiers Tiers of the engine in order of preference. Perturbation
+     *              resolves any view and belongs at the end.
+     */
+    PrecisionLadder(std::initializer_list<Precision> tiers);
+
+    Precision select(const View& view) const;
+
+    const vector<Precision>& get_tiers() const { return tiers; }
+};
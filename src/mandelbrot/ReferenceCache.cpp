@@ -0,0 +1,147 @@
+#include "ReferenceCache.h"
+
+#include "Config.h"
+
+#include <functional>
+#include <thread>
+
+
+// Extra mantissa bits, so zooming in doesn't need a new reference right away.
+static const int precision_reserve = 32;
+
+
+static std::shared_ptr<const ReferenceOrbit> compute_reference(BigFloat re, BigFloat im, int max_iterations, int precision)
+{
+    std::shared_ptr<ReferenceOrbit> reference(new ReferenceOrbit());
+    reference->compute(re, im, max_iterations, precision);
+
+    return reference;
+}
+
+
+ReferenceCache::ReferenceCache()
+{
+}
+
+
+ReferenceCache::~ReferenceCache()
+{
+}
+
+
+std::shared_ptr<const ReferenceOrbit> ReferenceCache::get(const View& view)
+{
+    collect(false);
+
+    if (current && fits(*current, view)) {
+        wanted.reset();
+        return current;
+    }
+
+    if (current && usable(*current, view)) {
+        if (!pending.valid()) {
+            wanted.reset(new View(view));
+        }
+
+        return current;
+    }
+
+    collect(true);
+
+    if (!current || !usable(*current, view)) {
+        if (config.verbosity_level() > 1) {
+            cout << "Computing reference orbit with " << view.get_precision() + precision_reserve << " bits" << endl;
+        }
+
+        current = compute_reference(view.center_re, view.center_im, view.max_iterations,
+                                    view.get_precision() + precision_reserve);
+
+        // The center escapes early, look for a longer lived point
+        if (current->has_escaped()) {
+            wanted.reset(new View(view));
+        }
+    }
+
+    return current;
+}
+
+
+void ReferenceCache::suggest(const BigFloat& re, const BigFloat& im)
+{
+    if (!wanted) {
+        return;
+    }
+
+    if (inside(re, im, *wanted, 1.0)) {
+        start(re, im, *wanted);
+    } else {
+        start(wanted->center_re, wanted->center_im, *wanted);
+    }
+
+    wanted.reset();
+}
+
+
+bool ReferenceCache::is_pending() const
+{
+    return pending.valid();
+}
+
+
+bool ReferenceCache::is_ready() const
+{
+    return pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+
+bool ReferenceCache::fits(const ReferenceOrbit& reference, const View& view) const
+{
+    return reference.covers(view.max_iterations) &&
+        reference.get_precision() >= view.get_precision() &&
+        inside(reference.get_re(), reference.get_im(), view, 1.0);
+}
+
+
+bool ReferenceCache::usable(const ReferenceOrbit& reference, const View& view) const
+{
+    return reference.covers(view.max_iterations) &&
+        reference.get_precision() + precision_reserve >= view.get_precision() &&
+        inside(reference.get_re(), reference.get_im(), view, 4.0);
+}
+
+
+/**
+ * Test if a point lies within the view, scaled around its center by frames.
+ */
+bool ReferenceCache::inside(const BigFloat& re, const BigFloat& im, const View& view, double frames) const
+{
+    const floatexp2 offset(floatexp(re - view.center_re), floatexp(im - view.center_im));
+    const floatexp2 extent = floatexp2(dvec2(view.size) * frames, 0) * view.mag;
+
+    return abs(offset.x()) <= extent.x() && abs(offset.y()) <= extent.y();
+}
+
+
+
+void ReferenceCache::collect(bool wait)
+{
+    if (!pending.valid()) {
+        return;
+    }
+
+    if (wait || pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        current = pending.get();
+    }
+}
+
+
+void ReferenceCache::start(const BigFloat& re, const BigFloat& im, const View& view)
+{
+    // Unlike std::async, a detached thread doesn't hold up the destructor
+    // when a computation is still running at exit.
+    std::packaged_task<std::shared_ptr<const ReferenceOrbit>()> task(
+        std::bind(compute_reference, re, im, view.max_iterations, view.get_precision() + precision_reserve));
+
+    pending = task.get_future();
+    std::thread(std::move(task)).detach();
+}
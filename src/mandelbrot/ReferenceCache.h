@@ -0,0 +1,70 @@
+#pragma once
+
+#include "common.h"
+
+#include "Perturbation.h"
+#include "View.h"
+
+#include <future>
+#include <memory>
+
+
+/**
+ * Keeps the reference orbit across frames.
+ * The orbit is reused as long as its point stays inside the visible frame
+ * and its precision and length suffice. Once the view has moved too far a
+ * new orbit is computed in the background while the old one keeps rendering.
+ */
+class ReferenceCache : public noncopyable
+{
+    std::shared_ptr<const ReferenceOrbit> current;
+    std::future<std::shared_ptr<const ReferenceOrbit>> pending;
+
+    scoped_ptr<View> wanted;
+
+    public:
+
+    ReferenceCache();
+    ~ReferenceCache();
+
+    /**
+     * Reference to render view with. Only blocks if no usable one exists.
+     */
+    std::shared_ptr<const ReferenceOrbit> get(const View& view);
+
+    /**
+     * Propose a point for the next reference after rendering a frame, e.g.
+     * the pixel with the most iterations. Starts the background computation
+     * if the last get() found the current reference too far off.
+     */
+    void suggest(const BigFloat& re, const BigFloat& im);
+
+    /**
+     * True while a new reference is being computed in the background.
+     */
+    bool is_pending() const;
+
+    /**
+     * True if the background computation finished and the next get() will
+     * return a new reference.
+     */
+    bool is_ready() const;
+
+    private:
+
+    /**
+     * The reference serves view without compromise.
+     */
+    bool fits(const ReferenceOrbit& reference, const View& view) const;
+
+    /**
+     * The reference may render view for a few frames until the next one is
+     * ready, at the cost of more glitches.
+     */
+    bool usable(const ReferenceOrbit& reference, const View& view) const;
+
+    bool inside(const BigFloat& re, const BigFloat& im, const View& view, double frames) const;
+
+    void collect(bool wait);
+    void start(const BigFloat& re, const BigFloat& im, const View& view);
+};
@@ -0,0 +1,513 @@
+#pragma once
+
+#include "Kernel.h"
+#include "OrbitBuffer.h"
+#include "Statistics.h"
+
+#include <immintrin.h>
+
+
+/**
+ * Start and end of code built for one instruction set. The translation units
+ * in kernels/ are compiled with the baseline flags and define SIMD_TARGET to
+ * their instruction set before including this header. Only the code below is
+ * built for it, while the inline functions it shares with the rest of the
+ * program (in_main_bulbs, PeriodicityCheck, IterationBuffer::row, ...) were
+ * included above and stay baseline, so the linker can't pick a copy of them
+ * that doesn't run on every CPU.
+ */
+#define SIMD_PRAGMA(x) _Pragma(#x)
+
+#ifdef __clang__
+#define SIMD_TARGET_BEGIN(isa) SIMD_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define SIMD_TARGET_END SIMD_PRAGMA(clang attribute pop)
+#else
+#define SIMD_TARGET_BEGIN(isa) SIMD_PRAGMA(GCC push_options) SIMD_PRAGMA(GCC target(isa))
+#define SIMD_TARGET_END SIMD_PRAGMA(GCC pop_options)
+#endif
+
+
+/**
+ * Thin wrappers around the double precision vector instructions of one ISA.
+ * A comparison yields a lane mask, bits() turns it into an integer with one
+ * bit per lane (movemask) for the loop exit test. FMA is left out of the
+ * targets and the kernels are built with -ffp-contract=off (AVX-512F
+ * includes FMA anyway): contracted multiply-adds round differently from
+ * the scalar kernel and change the counts of pixels near the boundary.
+ */
+namespace simd
+{
+
+SIMD_TARGET_BEGIN("sse4.1")
+    struct SSE4
+    {
+        typedef __m128d real;
+        typedef __m128d mask;
+
+        static const int width = 2;
+
+        static real set1(double v)            { return _mm_set1_pd(v); }
+        static real load(const double* p)     { return _mm_loadu_pd(p); }
+        static void store(double* p, real v)  { _mm_storeu_pd(p, v); }
+
+        static real add(real a, real b)       { return _mm_add_pd(a, b); }
+        static real sub(real a, real b)       { return _mm_sub_pd(a, b); }
+        static real mul(real a, real b)       { return _mm_mul_pd(a, b); }
+
+        static mask less(real a, real b)      { return _mm_cmplt_pd(a, b); }
+        static int bits(mask m)               { return _mm_movemask_pd(m); }
+        static mask both(mask a, mask b)      { return _mm_and_pd(a, b); }
+
+        static real add_masked(real a, mask m, real b) { return _mm_add_pd(a, _mm_and_pd(m, b)); }
+        static real select(mask m, real a, real b)     { return _mm_blendv_pd(b, a, m); }
+    };
+SIMD_TARGET_END
+
+SIMD_TARGET_BEGIN("avx2")
+    struct AVX2
+    {
+        typedef __m256d real;
+        typedef __m256d mask;
+
+        static const int width = 4;
+
+        static real set1(double v)            { return _mm256_set1_pd(v); }
+        static real load(const double* p)     { return _mm256_loadu_pd(p); }
+        static void store(double* p, real v)  { _mm256_storeu_pd(p, v); }
+
+        static real add(real a, real b)       { return _mm256_add_pd(a, b); }
+        static real sub(real a, real b)       { return _mm256_sub_pd(a, b); }
+        static real mul(real a, real b)       { return _mm256_mul_pd(a, b); }
+
+        static mask less(real a, real b)      { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static int bits(mask m)               { return _mm256_movemask_pd(m); }
+        static mask both(mask a, mask b)      { return _mm256_and_pd(a, b); }
+
+        static real add_masked(real a, mask m, real b) { return _mm256_add_pd(a, _mm256_and_pd(m, b)); }
+        static real select(mask m, real a, real b)     { return _mm256_blendv_pd(b, a, m); }
+    };
+SIMD_TARGET_END
+
+SIMD_TARGET_BEGIN("avx512f,avx2")
+    struct AVX512
+    {
+        typedef __m512d real;
+        typedef __mmask8 mask;
+
+        static const int width = 8;
+
+        static real set1(double v)            { return _mm512_set1_pd(v); }
+        static real load(const double* p)     { return _mm512_loadu_pd(p); }
+        static void store(double* p, real v)  { _mm512_storeu_pd(p, v); }
+
+        static real add(real a, real b)       { return _mm512_add_pd(a, b); }
+        static real sub(real a, real b)       { return _mm512_sub_pd(a, b); }
+        static real mul(real a, real b)       { return _mm512_mul_pd(a, b); }
+
+        static mask less(real a, real b)      { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        static int bits(mask m)               { return (int)m; }
+        static mask both(mask a, mask b)      { return a & b; }
+
+        static real add_masked(real a, mask m, real b) { return _mm512_mask_add_pd(a, m, a, b); }
+        static real select(mask m, real a, real b)     { return _mm512_mask_blend_pd(m, b, a); }
+    };
+SIMD_TARGET_END
+
+
+SIMD_TARGET_BEGIN(SIMD_TARGET)
+
+    /**
+     * Escape-time loop over a tile, V::width * U pixels at a time.
+     * U independent vectors are interleaved to hide the latency of the
+     * multiply-add chain. Lanes that have escaped keep going through the
+     * loop, but their mask stays clear, so their count and their last orbit
+     * point, which the smooth count needs, are frozen. Lanes in the main
+     * cardioid or period-2 bulb start out escaped and are marked interior at
+     * the end. Every periodicity_check iterations the lanes are checked for
+     * cycles on the scalar side, lanes caught in one get max_iterations and
+     * are pushed out of the escape radius. The
+     * loop ends right at max_iterations, so the lanes that reached it hold
+     * their last orbit point for args.orbits.
+     */
+    template<typename V, int U>
+    void escape_time(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+    {
+        typedef typename V::real real;
+        typedef typename V::mask mask;
+
+        const int W = V::width;
+        const int N = W * U;
+
+        const real one = V::set1(1.0);
+        const real two = V::set1(2.0);
+        const real four = V::set1(4.0);
+
+        double px[N];
+        double pz[N];
+        double counts[N];
+        bool interior[N];
+        bool settled[N];        // In the main bulbs or caught in a cycle
+
+        double lzx[N], lzy[N];
+        PeriodicityCheck<double> cycles[N];
+        int periodic = 0;
+
+        for (int y = tile.y; y < tile.y + tile.h; ++y) {
+            Pixel* out = buffer.row(y);
+            const double py = args.origin.y + args.lattice.get_pixel(0, y).y * args.step;
+
+            for (int x0 = tile.x; x0 < tile.x + tile.w; x0 += N) {
+
+                for (int i = 0; i < N; ++i) {
+                    px[i] = args.origin.x + args.lattice.get_pixel(x0 + i, 0).x * args.step;
+                    interior[i] = !args.julia && in_main_bulbs(px[i], py);
+                    settled[i] = interior[i];
+                    pz[i] = interior[i] ? 4.0 : 0.0;
+                }
+
+                real zx[U], zy[U], cx[U], cy[U], count[U];
+
+                for (int u = 0; u < U; ++u) {
+                    if (args.julia) {
+                        zx[u] = V::load(px + u*W);
+                        zy[u] = V::set1(py);
+                        cx[u] = V::set1(args.c.x);
+                        cy[u] = V::set1(args.c.y);
+                    } else {
+                        zx[u] = V::load(pz + u*W);
+                        zy[u] = V::set1(0.0);
+                        cx[u] = V::load(px + u*W);
+                        cy[u] = V::set1(py);
+                    }
+                    count[u] = V::set1(0.0);
+
+                    V::store(lzx + u*W, zx[u]);
+                    V::store(lzy + u*W, zy[u]);
+                }
+
+                for (int i = 0; i < N; ++i) {
+                    cycles[i].reset(lzx[i], lzy[i]);
+                }
+
+                int next_check = first_periodicity_check(args);
+
+                for (int it = 0; it < args.max_iterations; ++it) {
+                    int active = 0;
+
+                    for (int u = 0; u < U; ++u) {
+                        real x2 = V::mul(zx[u], zx[u]);
+                        real y2 = V::mul(zy[u], zy[u]);
+
+                        mask inside = V::less(V::add(x2, y2), four);
+                        active |= V::bits(inside);
+                        count[u] = V::add_masked(count[u], inside, one);
+
+                        real ny = V::add(V::mul(two, V::mul(zx[u], zy[u])), cy[u]);
+                        real nx = V::add(V::sub(x2, y2), cx[u]);
+
+                        zy[u] = V::select(inside, ny, zy[u]);
+                        zx[u] = V::select(inside, nx, zx[u]);
+                    }
+
+                    if (!active) break;
+
+                    if (it + 1 == next_check) {
+                        next_check += args.periodicity_check;
+
+                        bool found = false;
+
+                        for (int u = 0; u < U; ++u) {
+                            V::store(lzx + u*W, zx[u]);
+                            V::store(lzy + u*W, zy[u]);
+                            V::store(counts + u*W, count[u]);
+                        }
+
+                        // Only lanes that counted this iteration are still inside
+                        for (int i = 0; i < N; ++i) {
+                            if (counts[i] != it + 1 || !cycles[i].check(lzx[i], lzy[i], args.periodicity_tolerance)) continue;
+
+                            counts[i] = args.max_iterations;
+                            lzx[i] = 4.0;
+                            settled[i] = true;
+                            found = true;
+                            ++periodic;
+                        }
+
+                        if (found) {
+                            for (int u = 0; u < U; ++u) {
+                                zx[u] = V::load(lzx + u*W);
+                                count[u] = V::load(counts + u*W);
+                            }
+                        }
+                    }
+                }
+
+                for (int u = 0; u < U; ++u) {
+                    V::store(counts + u*W, count[u]);
+                    V::store(lzx + u*W, zx[u]);
+                    V::store(lzy + u*W, zy[u]);
+                }
+
+                const int n = minimum(N, tile.x + tile.w - x0);
+                for (int i = 0; i < n; ++i) {
+                    out[x0 + i] = interior[i] ? interior_pixel(args.max_iterations)
+                                              : orbit_pixel((int)counts[i], args.max_iterations, lzx[i] * lzx[i] + lzy[i] * lzy[i]);
+                }
+
+                if (args.orbits) {
+                    for (int i = 0; i < n; ++i) {
+                        if (settled[i]) {
+                            args.orbits->settle(x0 + i, y);
+                        } else if (counts[i] >= args.max_iterations) {
+                            args.orbits->save(x0 + i, y, dvec2(lzx[i], lzy[i]), args.max_iterations);
+                        }
+                    }
+                }
+            }
+        }
+
+        statistics.count_periodic(periodic);
+    }
+
+
+
+    /**
+     * Escape-time loop that keeps every lane busy until the tile is done.
+     * The pixels of the tile form a queue. Every R iterations, lanes that
+     * escaped or reached the iteration limit write out their count and are
+     * reloaded with the next queued pixel, instead of idling until the slowest
+     * lane of their vector finishes. Counts and orbit points stay masked in
+     * between, so the results are identical to the plain loop. Lanes only go
+     * idle once the queue is empty. Queued pixels in the main cardioid or
+     * period-2 bulb are written out directly instead of taking a lane. Cycle
+     * checks run between blocks of R iterations, roughly every
+     * periodicity_check iterations, and end lanes caught in a cycle at
+     * max_iterations.
+     * With S set lanes that reach the limit save their last orbit point to
+     * args.orbits, and continued pixels are loaded from there, see
+     * KernelArgs::continue_from.
+     */
+    template<typename V, int U, int R, bool S>
+    void refill_loop(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+    {
+        typedef typename V::real real;
+        typedef typename V::mask mask;
+
+        const int W = V::width;
+        const int all_lanes = (1 << W) - 1;
+
+        const real one = V::set1(1.0);
+        const real two = V::set1(2.0);
+        const real four = V::set1(4.0);
+        const real limit = V::set1(args.max_iterations);
+
+        const int pixel_count = tile.w * tile.h;
+        int next_pixel = 0;
+
+        real zx[U], zy[U], cx[U], cy[U], count[U];
+
+        int pixel[U][W];        // Queue index processed by each lane
+        int running[U];         // Lanes still iterating, one bit per lane
+        int idle[U];            // Lanes without work
+
+        double lzx[W], lzy[W], lcx[W], lcy[W], lcount[W];
+
+        PeriodicityCheck<double> cycles[U][W];
+        bool settled[U][W];     // Caught in a cycle
+        int periodic = 0;
+
+        const int check_blocks = args.periodicity_check > 0 ? maximum(args.periodicity_check / R, 1) : 0;
+        int blocks = 0;
+
+        // Write back finished lanes of vector u and refill them from the queue.
+        auto refill = [&](int u) {
+            V::store(lzx, zx[u]);
+            V::store(lzy, zy[u]);
+            V::store(lcx, cx[u]);
+            V::store(lcy, cy[u]);
+            V::store(lcount, count[u]);
+
+            for (int i = 0; i < W; ++i) {
+                if ((running[u] | idle[u]) & (1 << i)) continue;
+
+                if (pixel[u][i] >= 0) {
+                    const int p = pixel[u][i];
+                    buffer.row(tile.y + p / tile.w)[tile.x + p % tile.w] = orbit_pixel((int)lcount[i], args.max_iterations, lzx[i] * lzx[i] + lzy[i] * lzy[i]);
+
+                    if (S && settled[u][i]) {
+                        args.orbits->settle(tile.x + p % tile.w, tile.y + p / tile.w);
+                    } else if (S && lcount[i] >= args.max_iterations) {
+                        args.orbits->save(tile.x + p % tile.w, tile.y + p / tile.w, dvec2(lzx[i], lzy[i]), (int)lcount[i]);
+                    }
+                }
+
+                int p = -1;
+                double x = 0.0, y = 0.0;
+                int start = 0;  // Iteration of a continued orbit point
+
+                while (next_pixel < pixel_count) {
+                    const int q = next_pixel++;
+                    const int qx = tile.x + q % tile.w;
+                    const int qy = tile.y + q / tile.w;
+                    Pixel& out = buffer.row(qy)[qx];
+
+                    const ivec2 image = args.lattice.get_pixel(qx, qy);
+                    x = args.origin.x + image.x * args.step;
+                    y = args.origin.y + image.y * args.step;
+
+                    if (S && args.continue_from > 0) {
+                        // Escaped below the old limit, or not iterated at all
+                        if (!out.has(PIXEL_INTERIOR)) continue;
+
+                        start = args.orbits->get_iterations(qx, qy);
+
+                        if (start == orbit_settled) {
+                            out = interior_pixel(args.max_iterations);
+                            continue;
+                        }
+
+                        if (start > 0) {
+                            p = q;
+                            break;
+                        }
+                    }
+
+                    if (args.julia || !in_main_bulbs(x, y)) {
+                        p = q;
+                        break;
+                    }
+
+                    out = interior_pixel(args.max_iterations);
+                    if (S) args.orbits->settle(qx, qy);
+                }
+
+                if (p < 0) {
+                    // Park the lane where its mask stays clear.
+                    idle[u] |= 1 << i;
+                    pixel[u][i] = -1;
+                    lzx[i] = lzy[i] = lcx[i] = lcy[i] = 0.0;
+                    lcount[i] = args.max_iterations;
+                    continue;
+                }
+
+                pixel[u][i] = p;
+                running[u] |= 1 << i;
+                settled[u][i] = false;
+                lcount[i] = start;
+
+                if (start > 0) {
+                    const dvec2& z = args.orbits->get_z(tile.x + p % tile.w, tile.y + p / tile.w);
+                    lzx[i] = z.x;
+                    lzy[i] = z.y;
+                    lcx[i] = args.julia ? args.c.x : x;
+                    lcy[i] = args.julia ? args.c.y : y;
+                } else if (args.julia) {
+                    lzx[i] = x;
+                    lzy[i] = y;
+                    lcx[i] = args.c.x;
+                    lcy[i] = args.c.y;
+                } else {
+                    lzx[i] = lzy[i] = 0.0;
+                    lcx[i] = x;
+                    lcy[i] = y;
+                }
+
+                cycles[u][i].reset(lzx[i], lzy[i]);
+            }
+
+            zx[u] = V::load(lzx);
+            zy[u] = V::load(lzy);
+            cx[u] = V::load(lcx);
+            cy[u] = V::load(lcy);
+            count[u] = V::load(lcount);
+        };
+
+        // Lanes still running after a block counted its last iteration.
+        // The caught ones hit the iteration limit in the next block.
+        auto check_cycles = [&](int u) {
+            V::store(lzx, zx[u]);
+            V::store(lzy, zy[u]);
+            V::store(lcount, count[u]);
+
+            bool found = false;
+
+            for (int i = 0; i < W; ++i) {
+                if (!(running[u] & (1 << i))) continue;
+                if (!cycles[u][i].check(lzx[i], lzy[i], args.periodicity_tolerance)) continue;
+
+                lcount[i] = args.max_iterations;
+                settled[u][i] = true;
+                found = true;
+                ++periodic;
+            }
+
+            if (found) {
+                count[u] = V::load(lcount);
+            }
+        };
+
+        for (int u = 0; u < U; ++u) {
+            running[u] = 0;
+            idle[u] = 0;
+            for (int i = 0; i < W; ++i) {
+                pixel[u][i] = -1;
+            }
+            refill(u);
+        }
+
+        while (true) {
+            int busy = 0;
+
+            for (int u = 0; u < U; ++u) {
+                if ((running[u] | idle[u]) != all_lanes) {
+                    refill(u);
+                }
+                busy |= running[u];
+            }
+
+            if (!busy) break;
+
+            for (int r = 0; r < R; ++r) {
+                for (int u = 0; u < U; ++u) {
+                    real x2 = V::mul(zx[u], zx[u]);
+                    real y2 = V::mul(zy[u], zy[u]);
+
+                    mask inside = V::both(V::less(V::add(x2, y2), four),
+                                          V::less(count[u], limit));
+                    running[u] = V::bits(inside);
+                    count[u] = V::add_masked(count[u], inside, one);
+
+                    real ny = V::add(V::mul(two, V::mul(zx[u], zy[u])), cy[u]);
+                    real nx = V::add(V::sub(x2, y2), cx[u]);
+
+                    zy[u] = V::select(inside, ny, zy[u]);
+                    zx[u] = V::select(inside, nx, zx[u]);
+                }
+            }
+
+            if (check_blocks > 0 && ++blocks == check_blocks) {
+                blocks = 0;
+
+                for (int u = 0; u < U; ++u) {
+                    check_cycles(u);
+                }
+            }
+        }
+
+        statistics.count_periodic(periodic);
+    }
+
+
+    template<typename V, int U, int R>
+    void escape_time_refill(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+    {
+        if (args.orbits) {
+            refill_loop<V, U, R, true>(args, tile, buffer);
+        } else {
+            refill_loop<V, U, R, false>(args, tile, buffer);
+        }
+    }
+
+SIMD_TARGET_END
+
+}
@@ -0,0 +1,122 @@
+#include "Subdivision.h"
+
+
+/**
+ * Below this edge length the inside of a rectangle is rendered directly.
+ * The kernels fill their vector lanes poorly with the short rows and
+ * columns of smaller rectangles, which made them slower than iterating
+ * the whole inside.
+ */
+static const int min_subdivision_size = 32;
+
+
+static bool is_interior(const Tile& r, const IterationBuffer& buffer)
+{
+    const Pixel* top = buffer.row(r.y);
+    const Pixel* bottom = buffer.row(r.y + r.h - 1);
+
+    for (int x = r.x; x < r.x + r.w; ++x) {
+        if (!top[x].has(PIXEL_INTERIOR) || !bottom[x].has(PIXEL_INTERIOR)) return false;
+    }
+
+    for (int y = r.y + 1; y < r.y + r.h - 1; ++y) {
+        const Pixel* row = buffer.row(y);
+        if (!row[r.x].has(PIXEL_INTERIOR) || !row[r.x + r.w - 1].has(PIXEL_INTERIOR)) return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Iterate the middle row and column of the inside of a rectangle with an
+ * interior border. Catches filaments that cross the inside without
+ * touching a border pixel unless they are shorter than half of it.
+ *
+ * @param iterated Incremented by the number of pixels rendered.
+ * @return False if any of them is outside the set.
+ */
+static bool cross_is_interior(const SubdivisionArgs& args, const Tile& inside, IterationBuffer& buffer, int& iterated)
+{
+    const Tile row = { inside.x, inside.y + inside.h / 2, inside.w, 1 };
+    const Tile column = { inside.x + inside.w / 2, inside.y, 1, inside.h };
+
+    args.render(row);
+    args.render(column);
+    iterated += row.w + column.h;
+
+    return is_interior(row, buffer) && is_interior(column, buffer);
+}
+
+
+/**
+ * @param r Rectangle whose border is already rendered.
+ * @return Number of pixels iterated inside r.
+ */
+static int subdivide(const SubdivisionArgs& args, const Tile& r, IterationBuffer& buffer)
+{
+    if (r.w <= 2 || r.h <= 2) return 0;
+
+    const Tile inside = { r.x + 1, r.y + 1, r.w - 2, r.h - 2 };
+    const Pixel value = buffer.row(r.y)[r.x];
+    int iterated = 0;
+
+    if (is_interior(r, buffer) && cross_is_interior(args, inside, buffer, iterated)) {
+        for (int y = inside.y; y < inside.y + inside.h; ++y) {
+            std::fill_n(buffer.row(y) + inside.x, inside.w, value);
+        }
+        return iterated;
+    }
+
+    if (r.w < min_subdivision_size && r.h < min_subdivision_size) {
+        args.render(inside);
+        return iterated + inside.w * inside.h;
+    }
+
+    // Split across the longer side, the halves share the new line. It is
+    // part of the cross if that was rendered.
+    if (r.w >= r.h) {
+        const int mid = r.x + r.w / 2;
+        const Tile line = { mid, inside.y, 1, inside.h };
+        const Tile left = { r.x, r.y, mid - r.x + 1, r.h };
+        const Tile right = { mid, r.y, r.x + r.w - mid, r.h };
+
+        if (iterated == 0) {
+            args.render(line);
+            iterated = line.h;
+        }
+        return iterated + subdivide(args, left, buffer) + subdivide(args, right, buffer);
+    } else {
+        const int mid = r.y + r.h / 2;
+        const Tile line = { inside.x, mid, inside.w, 1 };
+        const Tile lower = { r.x, r.y, r.w, mid - r.y + 1 };
+        const Tile upper = { r.x, mid, r.w, r.y + r.h - mid };
+
+        if (iterated == 0) {
+            args.render(line);
+            iterated = line.w;
+        }
+        return iterated + subdivide(args, lower, buffer) + subdivide(args, upper, buffer);
+    }
+}
+
+
+int render_subdivided(const SubdivisionArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    if (!args.connected || tile.w <= 2 || tile.h <= 2) {
+        args.render(tile);
+        return tile.w * tile.h;
+    }
+
+    const Tile top = { tile.x, tile.y + tile.h - 1, tile.w, 1 };
+    const Tile bottom = { tile.x, tile.y, tile.w, 1 };
+    const Tile left = { tile.x, tile.y + 1, 1, tile.h - 2 };
+    const Tile right = { tile.x + tile.w - 1, tile.y + 1, 1, tile.h - 2 };
+
+    args.render(bottom);
+    args.render(top);
+    args.render(left);
+    args.render(right);
+
+    return 2 * tile.w + 2 * (tile.h - 2) + subdivide(args, tile, buffer);
+}
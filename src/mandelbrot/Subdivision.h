@@ -0,0 +1,45 @@
+#pragma once
+
+#include "common.h"
+
+#include "IterationBuffer.h"
+#include "Kernel.h"
+
+#include <functional>
+
+
+/**
+ * Parameters of the Mariani-Silver subdivision of one tile.
+ */
+struct SubdivisionArgs
+{
+    /**
+     * Renders every pixel of a rectangle, also single rows and columns.
+     */
+    std::function<void(const Tile& tile)> render;
+
+    /**
+     * False for Julia sets with c outside the Mandelbrot set. They have no
+     * interior, so tiles are rendered directly.
+     */
+    bool connected;
+};
+
+
+/**
+ * Renders a tile by Mariani-Silver subdivision. Only the border of the tile
+ * is iterated at first. If all border pixels are inside the set and the
+ * middle row and column of the inside are too, the inside is filled.
+ * Otherwise the tile is split in two along one of them, which becomes part
+ * of the borders of both halves. The exterior is connected to infinity, so
+ * a border inside the set can't enclose exterior pixels, but filaments
+ * thinner than a pixel can slip through a border between its pixels. The
+ * middle lines catch the longer ones, short ones and isolated exterior
+ * pixels may still be missing from filled rectangles. Exterior rectangles
+ * are never filled, their smooth counts differ from pixel to pixel.
+ * Glitched pixels count as exterior.
+ *
+ * @return Number of pixels iterated, borders shared with neighbouring tiles
+ *         are rendered by both.
+ */
+int render_subdivided(const SubdivisionArgs& args, const Tile& tile, IterationBuffer& buffer);
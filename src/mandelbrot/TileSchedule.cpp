@@ -0,0 +1,173 @@
+#include "TileSchedule.h"
+
+#include "Config.h"
+
+#include <algorithm>
+
+
+static uint64_t count_pixels(const vector<Tile>& tiles)
+{
+    uint64_t pixels = 0;
+
+    for (const Tile& tile : tiles) {
+        pixels += (uint64_t)tile.w * tile.h;
+    }
+
+    return pixels;
+}
+
+
+TileSchedule::TileSchedule()
+    : pixels_per_ms(0.0)
+    , continued_per_ms(0.0)
+    , continuing(false)
+{
+}
+
+
+void TileSchedule::start(const ivec2& size, const vector<Tile>& regions, int tile_size)
+{
+    passes = { { 1, ivec2(0,0), 1 } };
+    pending.clear();
+    continuing = false;
+
+    schedule(size, 0, regions, tile_size);
+}
+
+
+void TileSchedule::start_progressive(const ivec2& size, int tile_size)
+{
+    const double budget = config.frame_budget();
+    const double estimate = pixels_per_ms > 0.0 ? size.x * size.y / pixels_per_ms : 0.0;
+
+    if (!config.progressive() || !(budget > 0.0) || (pixels_per_ms > 0.0 && estimate <= budget)) {
+        start(size, { { 0, 0, size.x, size.y } }, tile_size);
+        return;
+    }
+
+    passes = { { 8, ivec2(0,0), 8 } };
+
+    for (int block = 4; block >= 1; block /= 2) {
+        passes.push_back({ 2 * block, ivec2(block, 0), block });
+        passes.push_back({ 2 * block, ivec2(0, block), block });
+        passes.push_back({ 2 * block, ivec2(block, block), block });
+    }
+
+    pending.clear();
+    continuing = false;
+
+    // Later passes go to the front, they are handed out last
+    for (int pass = (int)passes.size() - 1; pass >= 0; --pass) {
+        const ivec2 lattice = passes[pass].get_size(size);
+
+        schedule(lattice, pass, { { 0, 0, lattice.x, lattice.y } }, tile_size);
+    }
+}
+
+
+void TileSchedule::start_continuation(const ivec2& size, int tile_size)
+{
+    start(size, { { 0, 0, size.x, size.y } }, tile_size);
+
+    // Most pixels are skipped, which would overrate new views
+    continuing = true;
+}
+
+
+void TileSchedule::schedule(const ivec2& size, int pass, const vector<Tile>& regions, int tile_size)
+{
+    vector<Item> items;
+
+    for (const Tile& region : regions) {
+        for (int y = 0; y < region.h; y += tile_size) {
+            for (int x = 0; x < region.w; x += tile_size) {
+                items.push_back({ pass, { region.x + x, region.y + y, minimum(tile_size, region.w - x), minimum(tile_size, region.h - y) } });
+            }
+        }
+    }
+
+    const dvec2 center = dvec2(size) * 0.5;
+
+    auto distance = [&](const Item& item) {
+        return glm::length(dvec2(item.tile.x + 0.5 * item.tile.w, item.tile.y + 0.5 * item.tile.h) - center);
+    };
+
+    std::sort(items.begin(), items.end(), [&](const Item& a, const Item& b) {
+            return distance(a) > distance(b);
+        });
+
+    pending.insert(pending.end(), items.begin(), items.end());
+}
+
+
+Batch TileSchedule::next()
+{
+    const double budget = config.frame_budget() * (continuing ? continued_per_ms : pixels_per_ms);
+
+    Batch batch;
+    batch.pass = passes[pending.back().pass];
+
+    const int pass = pending.back().pass;
+    double pixels = 0.0;
+
+    while (!pending.empty() && pending.back().pass == pass) {
+        const Tile& tile = pending.back().tile;
+
+        // Always at least one tile
+        if (budget > 0.0 && !batch.tiles.empty() && pixels + tile.w * tile.h > budget) break;
+
+        pixels += tile.w * tile.h;
+        batch.tiles.push_back(tile);
+        pending.pop_back();
+    }
+
+    return batch;
+}
+
+
+void TileSchedule::finished(const Batch& batch, double milliseconds)
+{
+    if (milliseconds > 0.0) {
+        (continuing ? continued_per_ms : pixels_per_ms) = count_pixels(batch.tiles) / milliseconds;
+    }
+}
+
+
+void fill_blocks(const Pass& pass, const IterationBuffer& lattice, const vector<Tile>& tiles, IterationBuffer& buffer)
+{
+    const ivec2 size = buffer.get_size();
+
+    for (const Tile& tile : tiles) {
+        for (int j = tile.y; j < tile.y + tile.h; ++j) {
+            const Pixel* in = lattice.row(j);
+
+            const int y0 = pass.phase.y + j * pass.step;
+            const int y1 = minimum(y0 + pass.block, size.y);
+
+            for (int i = tile.x; i < tile.x + tile.w; ++i) {
+                const int x0 = pass.phase.x + i * pass.step;
+                const int w = minimum(pass.block, size.x - x0);
+
+                for (int y = y0; y < y1; ++y) {
+                    std::fill_n(buffer.row(y) + x0, w, in[i]);
+                }
+            }
+        }
+    }
+}
+
+
+void copy_orbits(const Pass& pass, const OrbitBuffer& lattice, const vector<Tile>& tiles, OrbitBuffer& orbits)
+{
+    for (const Tile& tile : tiles) {
+        for (int j = tile.y; j < tile.y + tile.h; ++j) {
+            const int y = pass.phase.y + j * pass.step;
+
+            for (int i = tile.x; i < tile.x + tile.w; ++i) {
+                const int x = pass.phase.x + i * pass.step;
+
+                orbits.save(x, y, lattice.get_z(i, j), lattice.get_iterations(i, j));
+            }
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "common.h"
+
+#include "IterationBuffer.h"
+#include "Kernel.h"
+#include "OrbitBuffer.h"
+
+
+/**
+ * The pixels phase + (i,j) * step of an image, rendered into a buffer of
+ * their own, see Lattice. Until finer passes cover it, each stands for the
+ * block x block square above and to the right of it.
+ */
+struct Pass
+{
+    int step;
+    ivec2 phase;
+    int block;
+
+    ivec2 get_size(const ivec2& image) const { return (image - phase + step - 1) / step; }
+};
+
+
+/**
+ * Tiles of one pass for one draw call, in pixels of the pass.
+ */
+struct Batch
+{
+    Pass pass;
+    vector<Tile> tiles;
+};
+
+
+/**
+ * Spreads the iteration of a frame over several draw calls, so slow views
+ * don't hold up the window. Each call gets as many tiles as fit into
+ * config.frame_budget() at the rate measured in the call before, those
+ * nearest to the image center first. Until the rate is known, and with a
+ * budget of 0, all tiles of a pass go at once.
+ *
+ * Progressive frames start with every 8th pixel in both directions, then
+ * fill in the pixels halfway between those done at 1/4, 1/2 and full
+ * resolution. Each pixel is iterated once.
+ */
+class TileSchedule
+{
+    struct Item
+    {
+        int pass;
+        Tile tile;
+    };
+
+    vector<Pass> passes;
+    vector<Item> pending;   /**< Handed out from the back. */
+    double pixels_per_ms;   /**< Measured rate, 0 if unknown. */
+    double continued_per_ms;
+    bool continuing;
+
+    public:
+
+    TileSchedule();
+
+    /**
+     * Drop the remaining tiles and cut the regions into new ones.
+     */
+    void start(const ivec2& size, const vector<Tile>& regions, int tile_size);
+
+    /**
+     * Drop the remaining tiles and schedule the whole image. Coarse passes
+     * come first if config.progressive() is set and the image probably
+     * won't fit into the budget.
+     */
+    void start_progressive(const ivec2& size, int tile_size);
+
+    /**
+     * Drop the remaining tiles and schedule the whole image for
+     * CPURenderer::continue_orbits(), which is timed on its own.
+     */
+    void start_continuation(const ivec2& size, int tile_size);
+
+    /**
+     * Tiles for the current draw call, only while not done.
+     */
+    Batch next();
+
+    /**
+     * Measure the rate from a batch returned by next().
+     */
+    void finished(const Batch& batch, double milliseconds);
+
+    bool is_done() const { return pending.empty(); }
+
+    private:
+
+    void schedule(const ivec2& size, int pass, const vector<Tile>& regions, int tile_size);
+};
+
+
+/**
+ * Copy the tiles of a pass into the image, each pixel into its block.
+ */
+void fill_blocks(const Pass& pass, const IterationBuffer& lattice, const vector<Tile>& tiles, IterationBuffer& buffer);
+
+
+/**
+ * Copy the orbit points of the tiles of a pass to their pixels in the image.
+ * The rest of each block gets its own in a finer pass. A lattice pixel has
+ * exactly the c of its image pixel, so the copies continue like orbits
+ * rendered at full resolution.
+ */
+void copy_orbits(const Pass& pass, const OrbitBuffer& lattice, const vector<Tile>& tiles, OrbitBuffer& orbits);
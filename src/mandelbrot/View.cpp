@@ -0,0 +1,141 @@
+#include "View.h"
+
+
+/**
+ * Largest distance in pixels from a whole pixel shift that still counts as
+ * one.
+ */
+static const double shift_tolerance = 1e-3;
+
+
+View::View(const dvec2& focus, const floatexp& mag, const ivec2& size, int max_iterations)
+    : focus(focus)
+    , mag(mag)
+    , size(size)
+    , max_iterations(max_iterations)
+    , center_re(focus.x, get_precision())
+    , center_im(focus.y, get_precision())
+{
+}
+
+
+int View::get_precision() const
+{
+    if (!(pixel_spacing() > 0.0)) {
+        return BigFloat::limb_bits;
+    }
+
+    // One guard limb on top of the bits of the pixel spacing.
+    return maximum(0, (int)ceil(-pixel_spacing().log2())) + BigFloat::limb_bits;
+}
+
+
+void View::pan(const floatexp2& offset)
+{
+    const int bits = get_precision();
+
+    if (center_re.get_precision() < bits) center_re.set_precision(bits);
+    if (center_im.get_precision() < bits) center_im.set_precision(bits);
+
+    center_re += offset.x().to_bigfloat(BigFloat::limb_bits);
+    center_im += offset.y().to_bigfloat(BigFloat::limb_bits);
+
+    focus = dvec2(center_re.to_double(), center_im.to_double());
+}
+
+
+bool View::get_shift(const View& previous, ivec2& shift) const
+{
+    if (mag != previous.mag || size != previous.size || max_iterations != previous.max_iterations) {
+        return false;
+    }
+
+    const floatexp spacing = pixel_spacing();
+
+    const dvec2 pixels((floatexp(center_re - previous.center_re) / spacing).to_double(),
+                       (floatexp(center_im - previous.center_im) / spacing).to_double());
+
+    // Pans by whole pixels only round in the last bits
+    const dvec2 rounded = glm::round(pixels);
+
+    if (!(glm::length(pixels - rounded) < shift_tolerance)) return false;
+    if (!(fabs(rounded.x) < size.x && fabs(rounded.y) < size.y)) return false;
+
+    shift = ivec2(rounded);
+    return true;
+}
+
+
+bool View::get_reprojection(const View& previous, double& scale, dvec2& offset) const
+{
+    if (size != previous.size || !(previous.mag > 0.0)) return false;
+
+    // Pixel centers (2 p - size) mag + center in both views, p at half pixels
+    const dvec2 distance((floatexp(center_re - previous.center_re) / previous.mag).to_double(),
+                         (floatexp(center_im - previous.center_im) / previous.mag).to_double());
+
+    scale = (mag / previous.mag).to_double();
+    offset = (dvec2(size) * (1.0 - scale) + distance) * 0.5;
+
+    return std::isfinite(scale) && std::isfinite(offset.x) && std::isfinite(offset.y);
+}
+
+
+View View::get_lattice(int step, const ivec2& phase) const
+{
+    View lattice(*this);
+    lattice.size = (size - phase + step - 1) / step;
+    lattice.mag = mag * floatexp(step);
+
+    // Lattice pixel (0,0) has to land on pixel phase
+    const dvec2 pixels = dvec2(2 * phase + 1 - size) + dvec2(lattice.size - 1) * (double)step;
+    lattice.pan(floatexp2(pixels) * mag);
+
+    return lattice;
+}
+
+
+bool View::set_center(const string& re, const string& im)
+{
+    BigFloat new_re, new_im;
+
+    if (!BigFloat::parse(re, get_precision(), new_re) ||
+        !BigFloat::parse(im, get_precision(), new_im)) {
+        return false;
+    }
+
+    center_re = new_re;
+    center_im = new_im;
+    focus = dvec2(center_re.to_double(), center_im.to_double());
+
+    return true;
+}
+
+
+bool View::has_same_pixels(const View& other) const
+{
+    return mag == other.mag && size == other.size && center_re == other.center_re && center_im == other.center_im;
+}
+
+
+bool View::operator== (const View& other) const
+{
+    return max_iterations == other.max_iterations && has_same_pixels(other);
+}
+
+
+int View::get_digits() const
+{
+    return maximum((int)ceil(-pixel_spacing().log2() * log10(2.0)) + 3, 17);
+}
+
+
+string View::to_string() const
+{
+    std::stringstream ss;
+    ss << center_re.to_string(get_digits()) << " "
+       << center_im.to_string(get_digits()) << " "
+       << mag.to_string();
+
+    return ss.str();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "common.h"
+
+#include "BigFloat.h"
+#include "FloatExp.h"
+
+
+/**
+ * Maps a pixel grid onto a region of the complex plane.
+ * Pixel (0,0) is the lower left corner, like in the GL framebuffer.
+ * The center is kept in arbitrary precision for deep zooms, focus is its
+ * double approximation used by the shallow renderers. mag has an extended
+ * exponent to zoom past the smallest double.
+ */
+struct View
+{
+    dvec2 focus;        /**< Complex coordinate of the image center. */
+    floatexp mag;       /**< Half the distance between two neighbouring pixels. */
+    ivec2 size;         /**< Image size in pixels. */
+    int max_iterations; /**< Iteration limit of the escape-time loop. */
+
+    BigFloat center_re; /**< Real part of the exact center. */
+    BigFloat center_im; /**< Imaginary part of the exact center. */
+
+    View(const dvec2& focus, const floatexp& mag, const ivec2& size, int max_iterations);
+
+    floatexp pixel_spacing() const
+    {
+        return mag * 2.0;
+    }
+
+    /**
+     * Pixel position in double precision for the shallow renderers.
+     */
+    dvec2 pixel_center(int x, int y) const
+    {
+        return focus + pixel_offset(x, y).to_dvec2();
+    }
+
+    /**
+     * Distance of a pixel from the center. Exact even when focus isn't.
+     */
+    floatexp2 pixel_offset(int x, int y) const
+    {
+        return floatexp2(dvec2(2*x+1, 2*y+1) - dvec2(size), 0) * mag;
+    }
+
+    /**
+     * Mantissa bits needed to resolve single pixels around the center.
+     */
+    int get_precision() const;
+
+    /**
+     * Move the center by a (small) offset without losing precision.
+     */
+    void pan(const floatexp2& offset);
+
+    /**
+     * Pixels this view is moved by against previous, if they only differ by
+     * a whole number of pixels. Pixel (x,y) of this view then lies at pixel
+     * (x,y) + shift of previous, which renderers reuse while panning.
+     * @return false if the views differ otherwise or share no pixels.
+     */
+    bool get_shift(const View& previous, ivec2& shift) const;
+
+    /**
+     * Where the pixels of this view lie in previous, to show its image while
+     * this view is rendered. Pixel coordinates p of this view map to
+     * p * scale + offset in previous, both measured in pixels from the lower
+     * left corner of the image.
+     * @return false if the images can't be mapped onto each other.
+     */
+    bool get_reprojection(const View& previous, double& scale, dvec2& offset) const;
+
+    /**
+     * View of the pixels phase + (i,j) * step of this one as its pixels
+     * (i,j), for coarse passes of the GL engine. Its pixel coordinates
+     * only match those of this view up to rounding, the CPU engine renders
+     * coarse passes with a Lattice instead.
+     */
+    View get_lattice(int step, const ivec2& phase) const;
+
+    /**
+     * Set the center from decimal strings.
+     * @return false if one of the strings can't be parsed.
+     */
+    bool set_center(const string& re, const string& im);
+
+    /**
+     * Significant decimal digits that pin the center down to a fraction of a
+     * pixel.
+     */
+    int get_digits() const;
+
+    /**
+     * Print the location as "re im mag" with all significant digits.
+     */
+    string to_string() const;
+
+    /**
+     * True if the views only differ in max_iterations.
+     */
+    bool has_same_pixels(const View& other) const;
+
+    bool operator== (const View& other) const;
+    bool operator!= (const View& other) const { return !(*this == other); }
+};
@@ -0,0 +1,14 @@
+#define SIMD_TARGET "avx2"
+#include "mandelbrot/SIMDKernel.h"
+
+
+void avx2_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    simd::escape_time<simd::AVX2, 4>(args, tile, buffer);
+}
+
+
+void avx2_refill_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    simd::escape_time_refill<simd::AVX2, 4, 8>(args, tile, buffer);
+}
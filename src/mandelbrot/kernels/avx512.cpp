@@ -0,0 +1,14 @@
+#define SIMD_TARGET "avx512f,avx2"
+#include "mandelbrot/SIMDKernel.h"
+
+
+void avx512_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    simd::escape_time<simd::AVX512, 4>(args, tile, buffer);
+}
+
+
+void avx512_refill_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    simd::escape_time_refill<simd::AVX512, 4, 8>(args, tile, buffer);
+}
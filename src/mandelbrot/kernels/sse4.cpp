@@ -0,0 +1,14 @@
+#define SIMD_TARGET "sse4.1"
+#include "mandelbrot/SIMDKernel.h"
+
+
+void sse4_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    simd::escape_time<simd::SSE4, 4>(args, tile, buffer);
+}
+
+
+void sse4_refill_kernel(const KernelArgs& args, const Tile& tile, IterationBuffer& buffer)
+{
+    simd::escape_time_refill<simd::SSE4, 4, 8>(args, tile, buffer);
+}
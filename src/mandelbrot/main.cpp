@@ -20,7 +20,11 @@
 
 #include <boost/format.hpp>
 #include <algorithm>
+#include <fstream>
+#include <iomanip>
 #include <random>
+#include <sstream>
+#include <thread>
 
 #include <Config.h>
 #include <GLConfig.h>
@@ -31,9 +35,15 @@
 #include "GL/Shader.h"
 
 #include "Mandelbrot.h"
+#include "CPUMandelbrot.h"
+#include "CPURenderer.h"
 #include "Julia.h"
 
 void mainloop(GLFWwindow* window);
+bool render_headless();
+bool run_benchmark();
+bool get_initial_view(View& view);
+bool save_location(const View& view);
 bool handle_arguments(int& argc, char** argv);
 GLFWwindow* init_opengl(ivec2 window_size);
 void get_framebuffer_info();
@@ -46,6 +56,14 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    if (config.benchmark()) {
+        return run_benchmark() ? 0 : 1;
+    }
+
+    if (config.headless()) {
+        return render_headless() ? 0 : 1;
+    }
+
     ivec2 size = config.window_size();
 
 	GLFWwindow* window = init_opengl(size);
@@ -74,13 +92,21 @@ void mainloop(GLFWwindow* window)
 
     long long frame_no = 0;
 
-    Mandelbrot mandelbrot;
+    scoped_ptr<Mandelbrot> mandelbrot;
+    scoped_ptr<CPUMandelbrot> cpu_mandelbrot;
 
-    const dvec2 initial_focus(-0.5,0.0);
-    const double initial_mag = 2.0/std::min(config.window_size().x,config.window_size().y);
-    
-    dvec2 focus = initial_focus;
-    double mag = initial_mag;
+    if (config.engine() == "cpu") {
+        cpu_mandelbrot.reset(new CPUMandelbrot());
+    } else {
+        mandelbrot.reset(new Mandelbrot());
+    }
+
+    View view(config.focus(), 0.0, config.window_size(), config.max_iterations());
+    if (!get_initial_view(view)) {
+        return;
+    }
+
+    const View initial_view = view;
 
     
     const int julia_window_size = 500;
@@ -92,10 +118,20 @@ void mainloop(GLFWwindow* window)
 
     glfwMakeContextCurrent(window);
     
+    bool cycling = false;
+    dvec2 pan_remainder(0,0);
+
     glfwPollEvents();
     while (running) {
 
-        if (keys.any_pressed()) {
+        // Keep drawing while a new reference orbit is on its way or tiles are left
+        bool refining = cpu_mandelbrot ? cpu_mandelbrot->is_refining() : mandelbrot->is_refining();
+        bool incomplete = cpu_mandelbrot ? cpu_mandelbrot->is_incomplete() : mandelbrot->is_incomplete();
+
+        if (keys.any_pressed() || cycling || incomplete) {
+            glfwPollEvents();
+        } else if (refining) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
             glfwPollEvents();
         } else {
             glfwWaitEvents();
@@ -115,20 +151,58 @@ void mainloop(GLFWwindow* window)
         }
 
         if (glm::length(mouse_movement) > 0.0 && glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT)) {
-            focus -= mouse_movement * mag * dvec2(2,-2);
+            // Whole pixels let the renderers reuse the last frame, the rest carries over
+            pan_remainder += -mouse_movement * dvec2(1,-1);
+
+            const dvec2 pixels = glm::round(pan_remainder);
+            pan_remainder -= pixels;
+
+            view.pan(floatexp2(pixels * 2.0) * view.mag);
         }
 
         if (keys.is_down(GLFW_KEY_UP)) {
-            mag *= exp(-time_diff);
+            view.mag *= exp(-time_diff);
         }
 
         if (keys.is_down(GLFW_KEY_DOWN)) {
-            mag *= exp(time_diff);
+            view.mag *= exp(time_diff);
         }
 
         if (keys.pressed('R')) {
-            focus = initial_focus;
-            mag = initial_mag;
+            view = initial_view;
+        }
+
+        // Double or halve the iteration limit, the CPU engine only continues the pixels that reached it
+        if (keys.pressed(GLFW_KEY_PAGE_UP)) {
+            view.max_iterations *= 2;
+        }
+
+        if (keys.pressed(GLFW_KEY_PAGE_DOWN)) {
+            view.max_iterations = maximum(view.max_iterations / 2, 1);
+        }
+
+        // Print the current location, e.g. to put it into mandelbrot.options
+        if (keys.pressed('P')) {
+            cout << view.to_string() << endl;
+        }
+
+        // Switch the GL engine between double and float pair arithmetic
+        if (keys.pressed('D')) {
+            config.set_df64(!config.df64());
+        }
+
+        // Cycle the palette, only the coloring pass reruns
+        if (keys.pressed('C')) {
+            cycling = !cycling;
+        }
+
+        if (cycling) {
+            config.set_palette_offset(config.palette_offset() + time_diff * config.palette_speed());
+        }
+
+        // Save the current location as the initial view of the next start
+        if (keys.pressed('S')) {
+            save_location(view);
         }
         
         // Make screenshot
@@ -141,7 +215,13 @@ void mainloop(GLFWwindow* window)
         glfwMakeContextCurrent(window);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        mandelbrot.draw(focus, mag);
+        view.size = config.window_size();
+
+        if (cpu_mandelbrot) {
+            cpu_mandelbrot->draw(view);
+        } else {
+            mandelbrot->draw(view);
+        }
         
         glfwSwapBuffers(window);
 
@@ -153,7 +233,7 @@ void mainloop(GLFWwindow* window)
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         dvec2 screen_center(config.window_size().x/2.0, config.window_size().y/2.0);
-        dvec2 c = (cursor_pos-screen_center)*mag*dvec2(2,-2)+focus;
+        dvec2 c = (cursor_pos-screen_center)*view.mag.to_double()*dvec2(2,-2)+view.focus;
         julia.draw(c);
         
         glfwSwapBuffers(julia_window);
@@ -170,12 +250,257 @@ void mainloop(GLFWwindow* window)
         frame_no++;
 
         keys.update();
-        //statistics.update();
+        statistics.update();
         last_cursor_pos = cursor_pos;
     }
 }
 
 
+/**
+ * Render the initial view with the CPU engine and save it without creating
+ * a GL context.
+ */
+bool render_headless()
+{
+    View view(config.focus(), 0.0, config.window_size(), config.max_iterations());
+    if (!get_initial_view(view)) {
+        return false;
+    }
+
+    CPURenderer renderer;
+    IterationBuffer buffer;
+
+    uint64_t start = nanotime();
+    renderer.render(view, buffer);
+    uint64_t duration = nanotime() - start;
+
+    if (config.verbosity_level() > 0) {
+        cout << format("Rendered %1%x%2% pixels in %3% ms on %4% threads (%5%)")
+            % view.size.x % view.size.y % (duration / (double)MILLION) % renderer.get_thread_count()
+            % renderer.get_kernel_name() << endl;
+
+        statistics.print_render_counters();
+    }
+
+    vector<unsigned char> rgb;
+    buffer.colorize(config.palette_offset(), rgb);
+
+    if (!save_image(config.output_file(), view.size.x, view.size.y, rgb.data())) {
+        cout << "Failed saving image in file \"" << config.output_file() << "\"." << endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Smooth counts of different arithmetic differ in their last bits, a
+ * hundredth of an iteration is far below what the palette shows.
+ */
+static bool differs(const Pixel& a, const Pixel& b)
+{
+    return a.flags != b.flags || std::abs(a.count - b.count) > 0.01f;
+}
+
+
+/**
+ * Render the initial view with each arithmetic the CPU engine offers, to find
+ * the depths where one becomes cheaper than another. Throughput counts the
+ * iterations of all pixels. Mismatches are counted against perturbation,
+ * which resolves views at any depth. Subdivision and exterior filling are
+ * compared with iterating every pixel in the arithmetic the ladder picks.
+ */
+bool run_benchmark()
+{
+    View view(config.focus(), 0.0, config.window_size(), config.max_iterations());
+    if (!get_initial_view(view)) {
+        return false;
+    }
+
+    CPURenderer renderer;
+    const string requested = config.precision();
+
+    cout << format("%1%x%2% pixels at %3% required bits on %4% threads")
+        % view.size.x % view.size.y % get_required_bits(view) % renderer.get_thread_count() << endl;
+
+    // Warm up the reference cache, perturbation would pay for the orbit otherwise
+    config.set_precision("perturbation");
+
+    IterationBuffer reference;
+    renderer.render(view, reference);
+
+    for (Precision precision : renderer.get_precision_tiers()) {
+        config.set_precision(get_precision_name(precision));
+
+        IterationBuffer buffer;
+
+        uint64_t start = nanotime();
+        renderer.render(view, buffer);
+        uint64_t duration = nanotime() - start;
+
+        int mismatches = 0;
+
+        for (int y = 0; y < view.size.y; ++y) {
+            for (int x = 0; x < view.size.x; ++x) {
+                mismatches += differs(buffer.row(y)[x], reference.row(y)[x]);
+            }
+        }
+
+        // The counts would overrate the tiers, pixels in the main bulbs,
+        // caught in a cycle or skipped by the series aren't iterated to them
+        const double pixels = (double)view.size.x * view.size.y;
+
+        cout << format("%1$-14s %2$10.1f ms %3$10.3f Mpixels/s %4$8d pixels differ from perturbation")
+            % get_precision_name(precision) % (duration / (double)MILLION)
+            % (pixels / duration * 1000.0) % mismatches << endl;
+    }
+
+    config.set_precision(requested);
+
+    // Both fill modes against iterating every pixel
+    const bool subdivision = config.subdivision();
+    const bool exterior_fill = config.exterior_fill();
+
+    config.set_subdivision(false);
+    config.set_exterior_fill(false);
+
+    IterationBuffer brute_force;
+
+    const uint64_t brute_force_start = nanotime();
+    renderer.render(view, brute_force);
+    const double brute_force_duration = (nanotime() - brute_force_start) / (double)MILLION;
+
+    for (int mode = 0; mode < 2; ++mode) {
+        config.set_subdivision(mode == 0);
+        config.set_exterior_fill(mode == 1);
+
+        IterationBuffer buffer;
+
+        // Views the mode doesn't apply to leave the counters alone
+        statistics.count_iterated(0, 0);
+
+        uint64_t start = nanotime();
+        renderer.render(view, buffer);
+        uint64_t duration = nanotime() - start;
+
+        const double iterated = statistics.image_pixels > 0 ? 100.0 * statistics.iterated_pixels / statistics.image_pixels : 100.0;
+        int mismatches = 0;
+
+        for (int y = 0; y < view.size.y; ++y) {
+            for (int x = 0; x < view.size.x; ++x) {
+                mismatches += differs(buffer.row(y)[x], brute_force.row(y)[x]);
+            }
+        }
+
+        cout << format("%1$-14s %2$10.1f ms %3$10.1f ms brute force %4$5.1f%% pixels iterated %5$8d pixels differ from brute force")
+            % (mode == 0 ? "subdivision" : "exterior_fill") % (duration / (double)MILLION) % brute_force_duration
+            % iterated % mismatches << endl;
+    }
+
+    config.set_subdivision(subdivision);
+    config.set_exterior_fill(exterior_fill);
+
+    return true;
+}
+
+
+/**
+ * Set up the view from focus/mag or, for deep locations, from the decimal
+ * center_re/center_im strings, and its iteration limit from max_iterations.
+ */
+bool get_initial_view(View& view)
+{
+    view.max_iterations = config.max_iterations();
+
+    floatexp mag;
+
+    if (!floatexp::parse(config.mag(), mag)) {
+        cout << "Invalid mag \"" << config.mag() << "\"." << endl;
+        return false;
+    }
+
+    if (mag > 0.0) {
+        view.mag = mag;
+    } else {
+        view.mag = 2.0/std::min(config.window_size().x,config.window_size().y);
+    }
+
+    if (!config.center_re().empty() || !config.center_im().empty()) {
+        if (!view.set_center(config.center_re(), config.center_im())) {
+            cout << "Invalid center \"" << config.center_re() << "\" \"" << config.center_im() << "\"." << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * Set the location keys in mandelbrot.options to the current view. The rest
+ * of the file stays as it is, so options changed at runtime or given on the
+ * command line aren't saved along. Missing keys go before the hash line.
+ */
+bool save_location(const View& view)
+{
+    std::ostringstream focus;
+    focus << std::setprecision(17) << view.focus.x << " " << view.focus.y;
+
+    const vector<std::pair<string, string>> location = {
+        { "focus",          focus.str() },
+        { "center_re",      view.center_re.to_string(view.get_digits()) },
+        { "center_im",      view.center_im.to_string(view.get_digits()) },
+        { "mag",            view.mag.to_string() },
+        { "max_iterations", std::to_string(view.max_iterations) },
+    };
+
+    vector<string> lines;
+    std::istringstream file(read_file("mandelbrot.options"));
+
+    for (string line; std::getline(file, line); ) {
+        lines.push_back(line);
+    }
+
+    for (const auto& key : location) {
+        const string line = key.first + " = " + key.second;
+
+        auto found = std::find_if(lines.begin(), lines.end(), [&](const string& l) {
+            const size_t end = l.find_first_of(" \t=");
+            return l.compare(0, end, key.first) == 0 && l.find('=', end) != string::npos;
+        });
+
+        if (found != lines.end()) {
+            *found = line;
+            continue;
+        }
+
+        auto hash = std::find_if(lines.begin(), lines.end(), [](const string& l) {
+            return l.compare(0, 6, "#hash:") == 0;
+        });
+
+        hash = lines.insert(hash, line);
+        lines.insert(hash + 1, "");
+    }
+
+    std::ofstream out("mandelbrot.options");
+
+    for (const string& line : lines) {
+        out << line << "\n";
+    }
+
+    if (!out) {
+        cout << "Failed to save mandelbrot.options" << endl;
+        return false;
+    }
+
+    if (config.verbosity_level() > 0) {
+        cout << "Saved location to mandelbrot.options" << endl;
+    }
+
+    return true;
+}
+
 
 bool handle_arguments(int& argc, char** argv)
 {
@@ -223,6 +548,11 @@ bool handle_arguments(int& argc, char** argv)
     config.parse_args(argc, argv); 
     gl_config.parse_args(argc, argv); 
 
+    if (config.engine() != "gl" && config.engine() != "cpu") {
+        cout << "Unknown engine \"" << config.engine() << "\"" << endl;
+        return false;
+    }
+
     return true;
 }
 
@@ -0,0 +1,285 @@
+#include "common.h"
+
+#include <boost/format.hpp>
+
+#include <Config.h>
+
+#include "mandelbrot/CPURenderer.h"
+#include "mandelbrot/TileSchedule.h"
+
+
+/**
+ * Regression test of the work the CPU engine saves. Fixed views are
+ * rendered with subdivision, exterior fill, progressive passes and
+ * continued orbits, and each is compared with iterating every pixel of the
+ * same view directly. All of them have to match pixel for pixel, except
+ * that exterior fill extrapolates the smooth counts of its squares, so
+ * those only have to come within exterior_fill_tolerance.
+ *
+ * The SSE4, AVX2 and AVX-512 kernels, with and without lane refill, have to
+ * produce the same buffers as the scalar kernel, for the Mandelbrot set and
+ * for a Julia set. Variants the CPU doesn't support are skipped.
+ *
+ * Perturbation with series approximation and BLA is compared with 128-bit
+ * fixed point on a view that needs more than double precision. Its smooth
+ * counts are rounded differently, so they only have to come within
+ * perturbation_tolerance.
+ *
+ * Exits with 1 if any view differs.
+ */
+
+
+/**
+ * Largest count difference of a filled exterior pixel. The extrapolation
+ * is least accurate where a pixel escapes right after the square's center.
+ */
+static const float exterior_fill_tolerance = 1.0f;
+
+
+/**
+ * Largest count difference between perturbation and fixed point pixels.
+ */
+static const float perturbation_tolerance = 0.1f;
+
+
+struct TestView
+{
+    const char* name;
+    View view;
+};
+
+
+static int count_differences(const IterationBuffer& a, const IterationBuffer& b, float tolerance)
+{
+    int differences = 0;
+
+    for (int y = 0; y < a.get_size().y; ++y) {
+        for (int x = 0; x < a.get_size().x; ++x) {
+            const Pixel& p = a.row(y)[x];
+            const Pixel& q = b.row(y)[x];
+
+            differences += p.flags != q.flags || std::abs(p.count - q.count) > tolerance;
+        }
+    }
+
+    return differences;
+}
+
+
+/**
+ * Print the result of one comparison.
+ * @return True if no pixel differs.
+ */
+static bool report(const char* view, const char* mode, int differences)
+{
+    cout << boost::format("%1$-10s %2$-14s %3%") % view % mode
+        % (differences == 0 ? string("ok") : (boost::format("%1% pixels differ") % differences).str()) << endl;
+
+    return differences == 0;
+}
+
+
+static void render_direct(CPURenderer& renderer, const View& view, IterationBuffer& buffer)
+{
+    renderer.render(view, buffer);
+}
+
+
+static void render_precision(CPURenderer& renderer, const View& view, const char* precision, IterationBuffer& buffer)
+{
+    config.set_precision(precision);
+    renderer.render(view, buffer);
+    config.set_precision("double");
+}
+
+
+/**
+ * Render with the kernels of one variant, a Julia set if julia is given.
+ */
+static void render_variant(const char* variant, bool lane_refill, const View& view, const dvec2* julia, IterationBuffer& buffer)
+{
+    config.set_cpu_kernel(variant);
+    config.set_lane_refill(lane_refill);
+
+    CPURenderer renderer;
+
+    if (julia) {
+        renderer.render_julia(view, *julia, buffer);
+    } else {
+        renderer.render(view, buffer);
+    }
+
+    config.set_cpu_kernel("auto");
+    config.set_lane_refill(true);
+}
+
+
+/**
+ * Compare every supported SIMD variant, with and without lane refill, with
+ * the scalar kernel.
+ * @return True if all of them match exactly.
+ */
+static bool compare_variants(const TestView& test, const dvec2* julia)
+{
+    const char* const variants[] = { "sse4", "avx2", "avx512" };
+
+    IterationBuffer scalar;
+    render_variant("scalar", false, test.view, julia, scalar);
+
+    bool passed = true;
+
+    for (const char* variant : variants) {
+        if (select_kernel_variant(variant).name != string(variant)) {
+            cout << boost::format("%1$-10s %2$-14s not supported") % test.name % variant << endl;
+            continue;
+        }
+
+        for (bool refill : { false, true }) {
+            IterationBuffer buffer;
+            render_variant(variant, refill, test.view, julia, buffer);
+
+            const string mode = string(variant) + (refill ? " refill" : "");
+            passed &= report(test.name, mode.c_str(), count_differences(buffer, scalar, 0.0f));
+        }
+    }
+
+    return passed;
+}
+
+
+static void render_subdivided(CPURenderer& renderer, const View& view, IterationBuffer& buffer)
+{
+    config.set_subdivision(true);
+    renderer.render(view, buffer);
+    config.set_subdivision(false);
+}
+
+
+static void render_filled(CPURenderer& renderer, const View& view, IterationBuffer& buffer)
+{
+    config.set_exterior_fill(true);
+    renderer.render(view, buffer);
+    config.set_exterior_fill(false);
+}
+
+
+/**
+ * Render in the coarse passes of TileSchedule like CPUMandelbrot does.
+ */
+static void render_progressive(CPURenderer& renderer, const View& view, IterationBuffer& buffer)
+{
+    TileSchedule schedule;
+    IterationBuffer lattice;
+
+    buffer.resize(view.size);
+    buffer.clear();
+
+    // Without a measured rate every view starts with the coarse passes
+    schedule.start_progressive(view.size, maximum(config.tile_size(), 1));
+
+    while (!schedule.is_done()) {
+        const Batch batch = schedule.next();
+
+        uint64_t start = nanotime();
+
+        if (batch.pass.step == 1) {
+            renderer.render(view, buffer, batch.tiles);
+        } else {
+            renderer.render_lattice(view, batch.pass.step, batch.pass.phase, lattice, batch.tiles);
+            fill_blocks(batch.pass, lattice, batch.tiles, buffer);
+        }
+
+        schedule.finished(batch, (nanotime() - start) / (double)MILLION);
+    }
+}
+
+
+/**
+ * Render with half the iteration limit, then continue the orbits that
+ * reached it up to the full one.
+ */
+static void render_continued(CPURenderer& renderer, const View& view, IterationBuffer& buffer)
+{
+    const vector<Tile> image = { { 0, 0, view.size.x, view.size.y } };
+
+    View shallow(view);
+    shallow.max_iterations = view.max_iterations / 2;
+
+    OrbitBuffer orbits;
+    orbits.resize(view.size);
+
+    buffer.resize(view.size);
+    buffer.clear();
+
+    renderer.render(shallow, buffer, image, &orbits);
+    renderer.continue_orbits(view, shallow.max_iterations, buffer, orbits, image);
+}
+
+
+int main()
+{
+    // Only the results, not which kernels and arithmetic each render used
+    config.set_verbosity_level(0);
+
+    // The double kernels are the only ones that keep orbits to continue
+    config.set_precision("double");
+    config.set_subdivision(false);
+    config.set_exterior_fill(false);
+
+    const ivec2 size(400, 300);
+
+    const vector<TestView> views = {
+        { "overview", View(dvec2(-0.5, 0.0), 1.0/100, size, 1000) },
+        { "seahorse", View(dvec2(-0.745, 0.113), 1e-5, size, 1024) },
+        { "minibrot", View(dvec2(-1.7687, 0.0017), 2e-6, size, 4096) },
+    };
+
+    struct Mode
+    {
+        const char* name;
+        void (*render)(CPURenderer& renderer, const View& view, IterationBuffer& buffer);
+        float tolerance;
+    };
+
+    const vector<Mode> modes = {
+        { "subdivision",   render_subdivided,  0.0f },
+        { "exterior_fill", render_filled,      exterior_fill_tolerance },
+        { "progressive",   render_progressive, 0.0f },
+        { "continuation",  render_continued,   0.0f },
+    };
+
+    CPURenderer renderer;
+    bool passed = true;
+
+    for (const TestView& test : views) {
+        IterationBuffer direct;
+        render_direct(renderer, test.view, direct);
+
+        for (const Mode& mode : modes) {
+            IterationBuffer buffer;
+            mode.render(renderer, test.view, buffer);
+
+            passed &= report(test.name, mode.name, count_differences(buffer, direct, mode.tolerance));
+        }
+    }
+
+    const TestView julia = { "julia", View(dvec2(0.0, 0.0), 3.0/400, size, 1000) };
+    const dvec2 julia_c(-0.745, 0.113);
+
+    for (const TestView& test : views) {
+        passed &= compare_variants(test, NULL);
+    }
+    passed &= compare_variants(julia, &julia_c);
+
+    // Pixels whose orbit passes close to the reference are the first to go
+    // wrong when the series skips too far.
+    const TestView deep = { "deep", View(dvec2(-0.7436438870371587, 0.1318259042053119), 1e-13, ivec2(200, 150), 1500) };
+
+    IterationBuffer fixed, perturbation;
+    render_precision(renderer, deep.view, "fixed128", fixed);
+    render_precision(renderer, deep.view, "perturbation", perturbation);
+
+    passed &= report(deep.name, "perturbation", count_differences(perturbation, fixed, perturbation_tolerance));
+
+    return passed ? 0 : 1;
+}